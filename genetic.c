@@ -1,16 +1,102 @@
 /* Genetic algorithm to explore xorshift-multiply-xorshift hashes.
  */
+#define _POSIX_C_SOURCE 200112L
 #include <math.h>
 #include <time.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#else
+static int omp_get_thread_num(void) { return 0; }
+static int omp_get_num_threads(void) { return 1; }
+static int omp_get_max_threads(void) { return 1; }
+#endif
 
 #define POOL      40
 #define THRESHOLD 2.0  // Use exact when estimate is below this
 #define DONTCARE  0.3  // Only print tuples with bias below this threshold
 #define QUALITY   18   // 2^N iterations of estimate samples
 #define RESETMINS 90   // Reset pool after this many minutes of no progress
+#define TRACE_MAX 65536 // most recent trace spans kept per thread
+
+/* Set asynchronously to stop after the current step. */
+static volatile sig_atomic_t stop;
+
+static void
+stop_handler(int sig)
+{
+    signal(sig, SIG_DFL);
+    stop = 1;
+}
+
+static uint64_t
+nsclock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
+/* Per-thread rings of timestamped spans, written only by their own
+ * thread and dumped as a Chrome trace at exit (-T). Tracing is off when
+ * trace_rings is null.
+ */
+static struct ring {
+    unsigned long long head;
+    struct span {
+        const char *name;
+        uint64_t beg, end;
+    } *spans;
+    char pad[64 - sizeof(unsigned long long) - sizeof(void *)];
+} *trace_rings;
+static int trace_nrings;
+static uint64_t trace_epoch;
+
+static void
+trace(const char *name, uint64_t beg, uint64_t end)
+{
+    if (!trace_rings)
+        return;
+    struct ring *r = trace_rings + omp_get_thread_num();
+    struct span *e = r->spans + (r->head++ & (TRACE_MAX - 1));
+    e->name = name;
+    e->beg = beg;
+    e->end = end;
+}
+
+static void
+trace_dump(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "genetic: %s: %s\n", path, strerror(errno));
+        return;
+    }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", f);
+    const char *sep = "\n";
+    for (int t = 0; t < trace_nrings; t++) {
+        struct ring *r = trace_rings + t;
+        unsigned long long i = r->head > TRACE_MAX ? r->head - TRACE_MAX : 0;
+        for (; i < r->head; i++) {
+            struct span *e = r->spans + (i & (TRACE_MAX - 1));
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    sep, e->name, t, (e->beg - trace_epoch) / 1e3,
+                    (e->end - e->beg) / 1e3);
+            sep = ",\n";
+        }
+    }
+    fputs("\n]}\n", f);
+    if (fclose(f))
+        fprintf(stderr, "genetic: %s: %s\n", path, strerror(errno));
+}
 
 static uint64_t
 rand64(uint64_t s[4])
@@ -76,30 +162,76 @@ estimate_bias32(const struct gene *g, uint64_t rng[4])
     return sqrt(mean) * 1000.0;
 }
 
-#define EXACT_SPLIT 32  // must be power of two
+#define EXACT_CHUNKS 4096  // must be power of two
+
+/* Work-stealing scheduler slot: the range of chunks owned by a thread,
+ * padded to its own cache line. Threads take chunks from their own slot
+ * first, then steal from the others.
+ */
+struct slot {
+    long long next;
+    long long end;
+    char pad[64 - 2 * sizeof(long long)];
+};
+
 static double
 exact_bias32(const struct gene *g)
 {
     long long bins[32][32] = {{0}};
-    static const uint64_t range = (UINT64_C(1) << 32) / EXACT_SPLIT;
-    #pragma omp parallel for
-    for (int i = 0; i < EXACT_SPLIT; i++) {
-        long long b[32][32] = {{0}};
-        for (uint64_t x = i * range; x < (i + 1) * range; x++) {
-            uint32_t h0 = hash(g, x);
-            for (int j = 0; j < 32; j++) {
-                uint32_t bit = UINT32_C(1) << j;
-                uint32_t h1 = hash(g, x ^ bit);
-                uint32_t set = h0 ^ h1;
-                for (int k = 0; k < 32; k++)
-                    b[j][k] += (set >> k) & 1;
+    static const uint64_t range = (UINT64_C(1) << 32) / EXACT_CHUNKS;
+    struct slot *slots = 0;
+#if _OPENMP >= 201307
+    #pragma omp parallel proc_bind(spread)
+#else
+    #pragma omp parallel
+#endif
+    {
+        int id = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        #pragma omp single
+        {
+            slots = calloc(nthreads, sizeof(*slots));
+            if (!slots)
+                abort();
+            for (int t = 0; t < nthreads; t++) {
+                slots[t].next = (long long)EXACT_CHUNKS * t / nthreads;
+                slots[t].end = (long long)EXACT_CHUNKS * (t + 1) / nthreads;
+            }
+        }
+
+        /* Allocated by its thread so it's local to its NUMA node */
+        long long (*b)[32] = calloc(32, sizeof(*b));
+        if (!b)
+            abort();
+        for (int v = 0; v < nthreads; v++) {
+            struct slot *slot = slots + (id + v) % nthreads;
+            while (!stop) {
+                long long c = __atomic_fetch_add(&slot->next, 1, __ATOMIC_RELAXED);
+                if (c >= slot->end)
+                    break;
+                uint64_t t0 = trace_rings ? nsclock() : 0;
+                for (uint64_t x = c * range; x < (c + 1) * range; x++) {
+                    uint32_t h0 = hash(g, x);
+                    for (int j = 0; j < 32; j++) {
+                        uint32_t bit = UINT32_C(1) << j;
+                        uint32_t h1 = hash(g, x ^ bit);
+                        uint32_t set = h0 ^ h1;
+                        for (int k = 0; k < 32; k++)
+                            b[j][k] += (set >> k) & 1;
+                    }
+                }
+                if (trace_rings)
+                    trace("chunk", t0, nsclock());
             }
         }
+
         #pragma omp critical
         for (int j = 0; j < 32; j++)
             for (int k = 0; k < 32; k++)
                 bins[j][k] += b[j][k];
+        free(b);
     }
+    free(slots);
     double mean = 0.0;
     for (int j = 0; j < 32; j++) {
         for (int k = 0; k < 32; k++) {
@@ -223,34 +355,170 @@ undup(struct gene *pool, uint64_t rng[4])
                 gene_mutate(pool + j, rng);
 }
 
+/* Save the whole population once per generation. Written to a
+ * temporary file and renamed so that a checkpoint is never torn.
+ */
+static void
+checkpoint_save(const char *path, uint64_t rng[POOL][4],
+                const struct gene *pool, double best, long since)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "genetic: %s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    fprintf(f, "genetic-checkpoint 1\n%.17g %ld\n", best, since);
+    for (int i = 0; i < POOL; i++) {
+        for (int j = 0; j < 4; j++)
+            fprintf(f, "%016llx ", (unsigned long long)rng[i][j]);
+        fprintf(f, "%d %08lx %d %08lx %d %u %.17g\n",
+                pool[i].s[0], (unsigned long)pool[i].c[0],
+                pool[i].s[1], (unsigned long)pool[i].c[1], pool[i].s[2],
+                pool[i].flags, pool[i].score);
+    }
+    int err = fflush(f);
+    err |= fsync(fileno(f));
+    err |= fclose(f);
+    if (err || rename(tmp, path))
+        fprintf(stderr, "genetic: %s: %s\n", path, strerror(errno));
+}
+
+/* Returns 0 if there's no checkpoint, or -1 if it's invalid.
+ */
+static int
+checkpoint_load(const char *path, uint64_t rng[POOL][4],
+                struct gene *pool, double *best, long *since)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    int ok = fscanf(f, "genetic-checkpoint 1 %lf %ld", best, since) == 2;
+    for (int i = 0; ok && i < POOL; i++) {
+        unsigned long long r[4];
+        unsigned long c[2];
+        ok = fscanf(f, "%llx %llx %llx %llx %hd %lx %hd %lx %hd %u %lf",
+                    r + 0, r + 1, r + 2, r + 3,
+                    pool[i].s + 0, c + 0, pool[i].s + 1, c + 1,
+                    pool[i].s + 2, &pool[i].flags, &pool[i].score) == 11;
+        for (int j = 0; j < 4; j++)
+            rng[i][j] = r[j];
+        pool[i].c[0] = c[0];
+        pool[i].c[1] = c[1];
+    }
+    fclose(f);
+    return ok ? 1 : -1;
+}
+
+static void
+usage(FILE *f)
+{
+    fprintf(f, "usage: genetic [-hR] [-C FILE] [-T FILE]\n");
+    fprintf(f, "  -C FILE  Save progress to a checkpoint file\n");
+    fprintf(f, "  -h       Print this help message\n");
+    fprintf(f, "  -R       Resume from the checkpoint file (-C)\n");
+    fprintf(f, "  -T FILE  Write a Chrome trace of each thread's work on exit\n");
+}
+
 int
-main(void)
+main(int argc, char **argv)
 {
     int verbose = 1;
+    int resume = 0;
+    char *checkpoint = 0;
+    char *tracefile = 0;
     double best = 1000.0;
     time_t best_time = time(0);
     uint64_t rng[POOL][4];
     struct gene pool[POOL];
 
-    rng_init(rng, sizeof(rng));
-    for (int i = 0; i < POOL; i++)
-        gene_gen(pool + i, rng[0]);
+    int option;
+    while ((option = getopt(argc, argv, "C:hRT:")) != -1) {
+        switch (option) {
+            case 'C': {
+                checkpoint = optarg;
+            } break;
+            case 'h': {
+                usage(stdout);
+                exit(EXIT_SUCCESS);
+            } break;
+            case 'R': {
+                resume = 1;
+            } break;
+            case 'T': {
+                tracefile = optarg;
+            } break;
+            default:
+                usage(stderr);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (resume && !checkpoint) {
+        fprintf(stderr, "genetic: -R requires -C\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (tracefile) {
+        trace_nrings = omp_get_max_threads();
+        trace_rings = calloc(trace_nrings, sizeof(*trace_rings));
+        if (!trace_rings)
+            abort();
+        for (int i = 0; i < trace_nrings; i++) {
+            trace_rings[i].spans = calloc(TRACE_MAX, sizeof(struct span));
+            if (!trace_rings[i].spans)
+                abort();
+        }
+        trace_epoch = nsclock();
+    }
+    signal(SIGINT, stop_handler);
 
-    for (;;) {
+    long since = 0;
+    switch (resume ? checkpoint_load(checkpoint, rng, pool, &best, &since) : 0) {
+        case 0: {
+            if (resume)
+                fprintf(stderr, "genetic: no checkpoint at %s, "
+                        "starting over\n", checkpoint);
+            rng_init(rng, sizeof(rng));
+            for (int i = 0; i < POOL; i++)
+                gene_gen(pool + i, rng[0]);
+        } break;
+        case -1: {
+            fprintf(stderr, "genetic: invalid checkpoint: %s\n", checkpoint);
+            exit(EXIT_FAILURE);
+        } break;
+        case 1: {
+            best_time -= since;
+        } break;
+    }
+
+    while (!stop) {
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < POOL; i++) {
             if (!(pool[i].flags & FLAG_SCORED)) {
+                uint64_t t0 = trace_rings ? nsclock() : 0;
                 pool[i].score = estimate_bias32(pool + i, rng[i]);
                 pool[i].flags |= FLAG_SCORED;
+                if (trace_rings)
+                    trace("estimate", t0, nsclock());
             }
         }
-        for (int i = 0; i < POOL; i++) {
+        for (int i = 0; i < POOL && !stop; i++) {
             if (!(pool[i].flags & FLAG_EXACT) && pool[i].score < THRESHOLD) {
-                pool[i].score = exact_bias32(pool + i);
+                uint64_t t0 = trace_rings ? nsclock() : 0;
+                double score = exact_bias32(pool + i);
+                if (trace_rings)
+                    trace("exact", t0, nsclock());
+                if (stop)
+                    break;  // interrupted, so the score is incomplete
+                pool[i].score = score;
                 pool[i].flags |= FLAG_EXACT;
             }
         }
+        if (stop)
+            break;
 
+        uint64_t t0 = trace_rings ? nsclock() : 0;
         qsort(pool, POOL, sizeof(*pool), cmp);
         if (verbose) {
             for (int i = 0; i < POOL; i++) {
@@ -279,5 +547,13 @@ main(void)
             for (int b = a + 1; c < POOL && b < POOL / 4; b++)
                 gene_cross(pool + c++, pool + a, pool + b, rng[0]);
         undup(pool, rng[0]);
+        if (trace_rings)
+            trace("breed", t0, nsclock());
+
+        if (checkpoint)
+            checkpoint_save(checkpoint, rng, pool, best, time(0) - best_time);
     }
+
+    if (tracefile)
+        trace_dump(tracefile);
 }
@@ -2,6 +2,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <math.h>
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -70,6 +71,7 @@ getopt(int argc, char * const argv[], const char *optstring)
 }
 
 #if defined(__unix__)
+#include <unistd.h>
 #include <sys/time.h>
 uint64_t
 uepoch(void)
@@ -79,6 +81,7 @@ uepoch(void)
     return 1000000LL * tv.tv_sec + tv.tv_usec;
 }
 #elif defined(_WIN32)
+#include <io.h>
 #include <windows.h>
 uint64_t
 uepoch(void)
@@ -94,6 +97,24 @@ uepoch(void)
 }
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+static int omp_get_thread_num(void) { return 0; }
+static int omp_get_num_threads(void) { return 1; }
+#endif
+
+/* Atomically increment and return the previous value. */
+static long long
+fetch_inc(long long *p)
+{
+#if defined(_MSC_VER)
+    return InterlockedExchangeAdd64(p, 1);
+#else
+    return __atomic_fetch_add(p, 1, __ATOMIC_RELAXED);
+#endif
+}
+
 static uint64_t
 rand64(uint64_t s[4])
 {
@@ -136,12 +157,18 @@ hash_equal(const struct hash *a, const struct hash *b)
 }
 
 static void
-hash_print(const struct hash *h)
+hash_fprint(const struct hash *h, FILE *f)
 {
-    putchar('[');
+    fputc('[', f);
     for (int i = 0; i < HASHN; i++)
-        printf("%2d %08lx ", h->s[i], (unsigned long)h->c[i]);
-    printf("%2d]", h->s[HASHN]);
+        fprintf(f, "%2d %08lx ", h->s[i], (unsigned long)h->c[i]);
+    fprintf(f, "%2d]", h->s[HASHN]);
+}
+
+static void
+hash_print(const struct hash *h)
+{
+    hash_fprint(h, stdout);
     fflush(stdout);
 }
 
@@ -211,31 +238,73 @@ estimate_bias32(const struct hash *f, uint64_t rng[4])
     return sqrt(mean) * 1000.0;
 }
 
-#define EXACT_SPLIT 32  // must be power of two
+#define EXACT_CHUNKS 4096  // must be power of two
+
+/* Work-stealing scheduler slot: the range of chunks owned by a thread,
+ * padded to its own cache line. Threads take chunks from their own slot
+ * first, then steal from the others.
+ */
+struct slot {
+    long long next;
+    long long end;
+    char pad[64 - 2 * sizeof(long long)];
+};
+
 static double
 exact_bias32(const struct hash *f)
 {
-    int i; // declare here to work around Visual Studio issue
     long long bins[32][32] = {{0}};
-    static const uint64_t range = (UINT64_C(1) << 32) / EXACT_SPLIT;
-    #pragma omp parallel for
-    for (i = 0; i < EXACT_SPLIT; i++) {
-        long long b[32][32] = {{0}};
-        for (uint64_t x = i * range; x < (i + 1) * range; x++) {
-            uint32_t h0 = hash(f, x);
-            for (int j = 0; j < 32; j++) {
-                uint32_t bit = UINT32_C(1) << j;
-                uint32_t h1 = hash(f, x ^ bit);
-                uint32_t set = h0 ^ h1;
-                for (int k = 0; k < 32; k++)
-                    b[j][k] += (set >> k) & 1;
+    static const uint64_t range = (UINT64_C(1) << 32) / EXACT_CHUNKS;
+    struct slot *slots = 0;
+#if _OPENMP >= 201307
+    #pragma omp parallel proc_bind(spread)
+#else
+    #pragma omp parallel
+#endif
+    {
+        int id = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        #pragma omp single
+        {
+            slots = calloc(nthreads, sizeof(*slots));
+            if (!slots)
+                abort();
+            for (int t = 0; t < nthreads; t++) {
+                slots[t].next = (long long)EXACT_CHUNKS * t / nthreads;
+                slots[t].end = (long long)EXACT_CHUNKS * (t + 1) / nthreads;
             }
         }
+
+        /* Allocated by its thread so it's local to its NUMA node */
+        long long (*b)[32] = calloc(32, sizeof(*b));
+        if (!b)
+            abort();
+        for (int v = 0; v < nthreads; v++) {
+            struct slot *slot = slots + (id + v) % nthreads;
+            for (;;) {
+                long long c = fetch_inc(&slot->next);
+                if (c >= slot->end)
+                    break;
+                for (uint64_t x = c * range; x < (c + 1) * range; x++) {
+                    uint32_t h0 = hash(f, x);
+                    for (int j = 0; j < 32; j++) {
+                        uint32_t bit = UINT32_C(1) << j;
+                        uint32_t h1 = hash(f, x ^ bit);
+                        uint32_t set = h0 ^ h1;
+                        for (int k = 0; k < 32; k++)
+                            b[j][k] += (set >> k) & 1;
+                    }
+                }
+            }
+        }
+
         #pragma omp critical
         for (int j = 0; j < 32; j++)
             for (int k = 0; k < 32; k++)
                 bins[j][k] += b[j][k];
+        free(b);
     }
+    free(slots);
     double mean = 0.0;
     for (int j = 0; j < 32; j++) {
         for (int k = 0; k < 32; k++) {
@@ -329,15 +398,114 @@ modinv32(uint32_t x)
     return x;
 }
 
+/* Climbing state saved after every exact evaluation. The step is the
+ * number of neighbors of cur already explored in this round.
+ */
+struct checkpoint {
+    uint64_t rng[4];
+    struct hash cur;
+    struct hash last;
+    struct hash best;
+    double cur_score;
+    double best_score;
+    int found;
+    int step;
+};
+
+/* Write to a temporary file, then rename it over the old checkpoint so
+ * that being killed mid-write never leaves a torn checkpoint.
+ */
+static void
+checkpoint_save(const char *path, const struct checkpoint *c)
+{
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "hillclimb: %s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    fprintf(f, "hillclimb-checkpoint 1\n");
+    for (int i = 0; i < 4; i++)
+        fprintf(f, "%016llx\n", (unsigned long long)c->rng[i]);
+    hash_fprint(&c->cur, f);
+    fputc('\n', f);
+    if (c->last.s[0])
+        hash_fprint(&c->last, f);
+    else
+        fputs("none", f);
+    fputc('\n', f);
+    hash_fprint(&c->best, f);
+    fprintf(f, "\n%.17g %.17g %d %d\n",
+            c->cur_score, c->best_score, c->found, c->step);
+    int err = fflush(f);
+#ifdef _WIN32
+    err |= _commit(_fileno(f));
+#else
+    err |= fsync(fileno(f));
+#endif
+    err |= fclose(f);
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (err || rename(tmp, path))
+        fprintf(stderr, "hillclimb: %s: %s\n", path, strerror(errno));
+}
+
+/* Returns 0 if there's no checkpoint, or -1 if it's invalid.
+ */
+static int
+checkpoint_load(const char *path, struct checkpoint *c)
+{
+    char line[256];
+    unsigned long long r;
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return 0;
+    int ok = fgets(line, sizeof(line), f) &&
+             !strcmp(line, "hillclimb-checkpoint 1\n");
+    for (int i = 0; ok && i < 4; i++) {
+        ok = fscanf(f, "%llx ", &r) == 1;
+        c->rng[i] = r;
+    }
+    ok = ok && fgets(line, sizeof(line), f) && hash_parse(&c->cur, line);
+    memset(&c->last, 0, sizeof(c->last));
+    ok = ok && fgets(line, sizeof(line), f) &&
+         (!strcmp(line, "none\n") || hash_parse(&c->last, line));
+    ok = ok && fgets(line, sizeof(line), f) && hash_parse(&c->best, line);
+    ok = ok && fscanf(f, "%lf %lf %d %d", &c->cur_score, &c->best_score,
+                      &c->found, &c->step) == 4;
+    fclose(f);
+    return ok ? 1 : -1;
+}
+
+/* Save the climbing state, if checkpointing (path is non-null).
+ */
+static void
+climb_save(const char *path, const uint64_t rng[4], const struct hash *cur,
+           const struct hash *last, const struct hash *best,
+           double cur_score, double best_score, int found, int step)
+{
+    if (path) {
+        struct checkpoint c = {
+            {rng[0], rng[1], rng[2], rng[3]},
+            *cur, *last, *best, cur_score, best_score, found, step
+        };
+        checkpoint_save(path, &c);
+    }
+}
+
 static void
 usage(FILE *f)
 {
-    fprintf(f, "usage: hillclimb [-EhIqs] [-p INIT] [-x SEED]\n");
+    fprintf(f, "usage: hillclimb [-EhIqRs] [-C FILE] [-p INIT] [-x SEED]\n");
+    fprintf(f, "  -C FILE  Save progress to a checkpoint file\n");
     fprintf(f, "  -E       Evaluate given pattern (-p)\n");
     fprintf(f, "  -h       Print this message and exit\n");
     fprintf(f, "  -I       Invert given pattern (-p) an quit\n");
     fprintf(f, "  -p INIT  Provide an initial hash function\n");
     fprintf(f, "  -q       Print less information (quiet)\n");
+    fprintf(f, "  -R       Resume from the checkpoint file (-C)\n");
     fprintf(f, "  -s       Quit after finding a local minima\n");
     fprintf(f, "  -x SEED  Seed PRNG from a string (up to 32 bytes)\n");
 }
@@ -353,11 +521,18 @@ main(int argc, char **argv)
     int quiet = 0;
     int invert = 0;
     int evaluate = 0;
+    int resume = 0;
+    int skip = 0;
+    char *checkpoint = 0;
+    struct checkpoint saved;
     double cur_score = -1;
 
     int option;
-    while ((option = getopt(argc, argv, "EhIp:qsx:")) != -1) {
+    while ((option = getopt(argc, argv, "C:EhIp:qRsx:")) != -1) {
         switch (option) {
+            case 'C': {
+                checkpoint = optarg;
+            } break;
             case 'E': {
                 evaluate = 1;
             } break;
@@ -378,6 +553,9 @@ main(int argc, char **argv)
             case 'q': {
                 quiet++;
             } break;
+            case 'R': {
+                resume = 1;
+            } break;
             case 's': {
                 one_shot = 1;
             } break;
@@ -438,6 +616,33 @@ main(int argc, char **argv)
         exit(EXIT_SUCCESS);
     }
 
+    if (resume) {
+        if (!checkpoint) {
+            fprintf(stderr, "hillclimb: -R requires -C\n");
+            exit(EXIT_FAILURE);
+        }
+        switch (checkpoint_load(checkpoint, &saved)) {
+            case 0: {
+                fprintf(stderr, "hillclimb: no checkpoint at %s, "
+                        "starting over\n", checkpoint);
+            } break;
+            case -1: {
+                fprintf(stderr, "hillclimb: invalid checkpoint: %s\n",
+                        checkpoint);
+                exit(EXIT_FAILURE);
+            } break;
+            case 1: {
+                memcpy(rng, saved.rng, sizeof(rng));
+                cur = saved.cur;
+                last = saved.last;
+                cur_score = saved.cur_score;
+                skip = saved.step;
+                seeded = 1;
+                generate = 0;
+            } break;
+        }
+    }
+
     if (!seeded)
         rng_init(rng);
 
@@ -446,6 +651,7 @@ main(int argc, char **argv)
 
     for (;;) {
         int found = 0;
+        int step = 0;
         struct hash best;
         double best_score;
 
@@ -458,6 +664,15 @@ main(int argc, char **argv)
 
         best = cur;
         best_score = cur_score;
+        if (skip) {
+            /* Resuming partway through this round */
+            best = saved.best;
+            best_score = saved.best_score;
+            found = saved.found;
+        }
+        if (!skip)  // a resumed round is already saved as it was
+            climb_save(checkpoint, rng, &cur, &last, &best,
+                       cur_score, best_score, found, step);
 
         /* Explore around shifts */
         for (int i = 0; i <= HASHN; i++) {
@@ -470,6 +685,7 @@ main(int argc, char **argv)
                 struct hash tmp = cur;
                 tmp.s[i] += d;
                 if (hash_equal(&tmp, &last)) continue;
+                if (step++ < skip) continue;
                 if (quiet <= 0) {
                     printf("  ");
                     hash_print(&tmp);
@@ -482,6 +698,8 @@ main(int argc, char **argv)
                     best = tmp;
                     found = 1;
                 }
+                climb_save(checkpoint, rng, &cur, &last, &best,
+                           cur_score, best_score, found, step);
             }
         }
 
@@ -492,6 +710,7 @@ main(int argc, char **argv)
                 struct hash tmp = cur;
                 tmp.c[i] += d;
                 if (hash_equal(&tmp, &last)) continue;
+                if (step++ < skip) continue;
                 if (quiet <= 0) {
                     printf("  ");
                     hash_print(&tmp);
@@ -504,9 +723,13 @@ main(int argc, char **argv)
                     best = tmp;
                     found = 1;
                 }
+                climb_save(checkpoint, rng, &cur, &last, &best,
+                           cur_score, best_score, found, step);
             }
         }
 
+        skip = 0;
+
         if (found) {
             /* Move to the lowest item found */
             if (quiet < 1)
@@ -4,13 +4,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
+#include <time.h>
 
 #include <fcntl.h>
 #include <dlfcn.h>
+#include <signal.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#else
+static int omp_get_thread_num(void) { return 0; }
+static int omp_get_num_threads(void) { return 1; }
+static int omp_get_max_threads(void) { return 1; }
+typedef int omp_lock_t;
+static void omp_init_lock(omp_lock_t *l) { (void)l; }
+static void omp_destroy_lock(omp_lock_t *l) { (void)l; }
+static void omp_set_lock(omp_lock_t *l) { (void)l; }
+static void omp_unset_lock(omp_lock_t *l) { (void)l; }
+#endif
 
 #define ABI __attribute__((sysv_abi))
 
@@ -28,6 +48,23 @@ xoroshiro128plus(uint64_t s[2])
     return result;
 }
 
+static uint64_t
+uepoch(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return 1000000LL * tv.tv_sec + tv.tv_usec;
+}
+
+/* Monotonic nanoseconds, for timing short intervals. */
+static uint64_t
+nsclock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+}
+
 enum hf_type {
     /* 32 bits */
     HF32_XOR,  // x ^= const32
@@ -40,6 +77,10 @@ enum hf_type {
     HF32_XORR, // x ^= x >> const5
     HF32_ADDL, // x += x << const5
     HF32_SUBL, // x -= x << const5
+    HF32_CRC,  // x  = crc32c(0, x)
+    HF32_AES,  // x  = aesenc(broadcast(x), 0), low word
+    HF32_CLMUL,// x  = clmul(x, const32) (odd), low word
+    HF32_PEXT, // x  = pext(x, const32) | pext(x, ~const32) << popcount
     /* 64 bits */
     HF64_XOR,
     HF64_MUL,
@@ -51,6 +92,10 @@ enum hf_type {
     HF64_XORR,
     HF64_ADDL,
     HF64_SUBL,
+    HF64_CRC,  // x ^= crc32c(0, x >> 32)
+    HF64_AES,
+    HF64_CLMUL,
+    HF64_PEXT,
 };
 
 static const char hf_names[][8] = {
@@ -64,6 +109,10 @@ static const char hf_names[][8] = {
     [HF32_XORR] = "32xorr",
     [HF32_ADDL] = "32addl",
     [HF32_SUBL] = "32subl",
+    [HF32_CRC]  = "32crc",
+    [HF32_AES]  = "32aes",
+    [HF32_CLMUL]= "32clmul",
+    [HF32_PEXT] = "32pext",
     [HF64_XOR]  = "64xor",
     [HF64_MUL]  = "64mul",
     [HF64_ADD]  = "64add",
@@ -74,6 +123,10 @@ static const char hf_names[][8] = {
     [HF64_XORR] = "64xorr",
     [HF64_ADDL] = "64addl",
     [HF64_SUBL] = "64subl",
+    [HF64_CRC]  = "64crc",
+    [HF64_AES]  = "64aes",
+    [HF64_CLMUL]= "64clmul",
+    [HF64_PEXT] = "64pext",
 };
 
 #define FOP_LOCKED  (1 << 0)
@@ -94,6 +147,10 @@ hf_randomize(struct hf_op *op, uint64_t s[2])
         case HF64_NOT:
         case HF32_BSWAP:
         case HF64_BSWAP:
+        case HF32_CRC:
+        case HF64_CRC:
+        case HF32_AES:
+        case HF64_AES:
             op->constant = 0;
             break;
         case HF32_XOR:
@@ -101,8 +158,14 @@ hf_randomize(struct hf_op *op, uint64_t s[2])
             op->constant = (uint32_t)r;
             break;
         case HF32_MUL:
+        case HF32_CLMUL:
             op->constant = (uint32_t)r | 1;
             break;
+        case HF32_PEXT:
+            /* Avoid the masks that leave x unchanged */
+            op->constant = (uint32_t)r ^ ((uint32_t)r == 0 ||
+                                          (uint32_t)r == 0xffffffff);
+            break;
         case HF32_ROT:
         case HF32_XORL:
         case HF32_XORR:
@@ -115,8 +178,12 @@ hf_randomize(struct hf_op *op, uint64_t s[2])
             op->constant = r;
             break;
         case HF64_MUL:
+        case HF64_CLMUL:
             op->constant = r | 1;
             break;
+        case HF64_PEXT:
+            op->constant = r ^ (r == 0 || r == UINT64_MAX);
+            break;
         case HF64_ROT:
         case HF64_XORL:
         case HF64_XORR:
@@ -129,13 +196,20 @@ hf_randomize(struct hf_op *op, uint64_t s[2])
 
 #define F_U64     (1 << 0)
 #define F_TINY    (1 << 1)  // don't use big constants
+#define F_HW      (1 << 2)  // also use crc, aes, clmul, and pext
 
 static void
 hf_gen(struct hf_op *op, uint64_t s[2], int flags)
 {
+    static const enum hf_type hw[] = {
+        HF32_CRC, HF32_AES, HF32_CLMUL, HF32_PEXT
+    };
     uint64_t r = xoroshiro128plus(s);
     int min = flags & F_TINY ? 3 : 0;
-    op->type = (r % (9 - min)) + min + (flags & F_U64 ? 9 : 0);
+    int nhw = flags & F_HW ? (flags & F_TINY ? 2 : 4) : 0;
+    int i = r % (9 - min + nhw);
+    int type = i < 9 - min ? i + min : (int)hw[i - (9 - min)];
+    op->type = type + (flags & F_U64 ? HF64_XOR : 0);
     hf_randomize(op, s);
 }
 
@@ -157,6 +231,14 @@ hf_type_valid(enum hf_type a, enum hf_type b)
         case HF64_MUL:
         case HF64_ADD:
         case HF64_ROT:
+        case HF32_CRC:
+        case HF32_AES:
+        case HF32_CLMUL:
+        case HF32_PEXT:
+        case HF64_CRC:
+        case HF64_AES:
+        case HF64_CLMUL:
+        case HF64_PEXT:
             return a != b;
         case HF32_XORL:
         case HF32_XORR:
@@ -255,435 +337,113 @@ hf_print(const struct hf_op *op, char *buf)
         case HF64_SUBL:
             sprintf(buf, "x -= x << %llu;", c);
             break;
+        case HF32_CRC:
+            sprintf(buf, "x  = _mm_crc32_u32(0, x);");
+            break;
+        case HF64_CRC:
+            sprintf(buf, "x ^= _mm_crc32_u32(0, x >> 32);");
+            break;
+        case HF32_AES:
+            sprintf(buf, "x  = _mm_cvtsi128_si32(_mm_aesenc_si128("
+                    "_mm_set1_epi32(x), _mm_setzero_si128()));");
+            break;
+        case HF64_AES:
+            sprintf(buf, "x  = _mm_cvtsi128_si64(_mm_aesenc_si128("
+                    "_mm_set1_epi64x(x), _mm_setzero_si128()));");
+            break;
+        case HF32_CLMUL:
+            sprintf(buf, "x  = _mm_cvtsi128_si32(_mm_clmulepi64_si128("
+                    "_mm_cvtsi32_si128(x), _mm_cvtsi32_si128(0x%08llx), 0));",
+                    c);
+            break;
+        case HF64_CLMUL:
+            sprintf(buf, "x  = _mm_cvtsi128_si64(_mm_clmulepi64_si128("
+                    "_mm_cvtsi64_si128(x), _mm_cvtsi64_si128(0x%016llx), 0));",
+                    c);
+            break;
+        case HF32_PEXT:
+            if (c == 0xffffffff)
+                sprintf(buf, "x  = _pext_u32(x, 0x%08llx);", c);
+            else
+                sprintf(buf, "x  = _pext_u32(x, 0x%08llx) | "
+                        "_pext_u32(x, 0x%08llx) << %d;",
+                        c, ~c & 0xffffffff, __builtin_popcountll(c));
+            break;
+        case HF64_PEXT:
+            if (c == UINT64_MAX)
+                sprintf(buf, "x  = _pext_u64(x, 0x%016llx);", c);
+            else
+                sprintf(buf, "x  = _pext_u64(x, 0x%016llx) | "
+                        "_pext_u64(x, 0x%016llx) << %d;",
+                        c, ~c, __builtin_popcountll(c));
+            break;
     }
 }
 
 static void
 hf_printfunc(const struct hf_op *ops, int n, FILE *f)
 {
-    if (ops[0].type <= HF32_SUBL)
+    if (ops[0].type < HF64_XOR)
         fprintf(f, "uint32_t\nhash(uint32_t x)\n{\n");
     else
         fprintf(f, "uint64_t\nhash(uint64_t x)\n{\n");
     for (int i = 0; i < n; i++) {
-        char buf[64];
+        char buf[128];
         hf_print(ops + i, buf);
         fprintf(f, "    %s\n", buf);
     }
     fprintf(f, "    return x;\n}\n");
 }
 
-static unsigned char *
-hf_compile(const struct hf_op *ops, int n, unsigned char *buf)
-{
-    if (ops[0].type <= HF32_SUBL) {
-        /* mov eax, edi*/
-        *buf++ = 0x89;
-        *buf++ = 0xf8;
-    } else {
-        /* mov rax, rdi*/
-        *buf++ = 0x48;
-        *buf++ = 0x89;
-        *buf++ = 0xf8;
-    }
+#define TEMPLATE_MAX 1024  // buffer size for hf_template()
 
+/* Write the function in the template notation accepted by -p.
+ */
+static void
+hf_template(const struct hf_op *ops, int n, char *buf)
+{
     for (int i = 0; i < n; i++) {
+        unsigned long long c = ops[i].constant;
+        buf += sprintf(buf, "%s%s", i ? "," : "", hf_names[ops[i].type] + 2);
         switch (ops[i].type) {
             case HF32_NOT:
-                /* not eax */
-                *buf++ = 0xf7;
-                *buf++ = 0xd0;
-                break;
+            case HF64_NOT:
             case HF32_BSWAP:
-                /* bswap eax */
-                *buf++ = 0x0f;
-                *buf++ = 0xc8;
+            case HF64_BSWAP:
+            case HF32_CRC:
+            case HF64_CRC:
+            case HF32_AES:
+            case HF64_AES:
                 break;
             case HF32_XOR:
-                /* xor eax, imm32 */
-                *buf++ = 0x35;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
-                break;
             case HF32_MUL:
-                /* imul eax, eax, imm32 */
-                *buf++ = 0x69;
-                *buf++ = 0xc0;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
-                break;
             case HF32_ADD:
-                /* add eax, imm32 */
-                *buf++ = 0x05;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
+            case HF32_CLMUL:
+            case HF32_PEXT:
+                buf += sprintf(buf, ":%08llx", c);
                 break;
-            case HF32_ROT:
-                /* rol eax, imm8 */
-                *buf++ = 0xc1;
-                *buf++ = 0xc0;
-                *buf++ = ops[i].constant;
+            case HF64_XOR:
+            case HF64_MUL:
+            case HF64_ADD:
+            case HF64_CLMUL:
+            case HF64_PEXT:
+                buf += sprintf(buf, ":%016llx", c);
                 break;
+            case HF32_ROT:
             case HF32_XORL:
-                /* mov edi, eax */
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl edi, imm8 */
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* xor eax, edi */
-                *buf++ = 0x31;
-                *buf++ = 0xf8;
-                break;
             case HF32_XORR:
-                /* mov edi, eax */
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shr edi, imm8 */
-                *buf++ = 0xc1;
-                *buf++ = 0xef;
-                *buf++ = ops[i].constant;
-                /* xor eax, edi */
-                *buf++ = 0x31;
-                *buf++ = 0xf8;
-                break;
             case HF32_ADDL:
-                /* mov edi, eax */
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl edi, imm8 */
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* add eax, edi */
-                *buf++ = 0x01;
-                *buf++ = 0xf8;
-                break;
             case HF32_SUBL:
-                /* mov edi, eax */
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl edi, imm8 */
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* sub eax, edi */
-                *buf++ = 0x29;
-                *buf++ = 0xf8;
-                break;
-            case HF64_NOT:
-                /* not rax */
-                *buf++ = 0x48;
-                *buf++ = 0xf7;
-                *buf++ = 0xd0;
-                break;
-            case HF64_BSWAP:
-                /* bswap rax */
-                *buf++ = 0x48;
-                *buf++ = 0x0f;
-                *buf++ = 0xc8;
-                break;
-            case HF64_XOR:
-                /* mov rdi, imm64 */
-                *buf++ = 0x48;
-                *buf++ = 0xbf;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
-                *buf++ = ops[i].constant >> 32;
-                *buf++ = ops[i].constant >> 40;
-                *buf++ = ops[i].constant >> 48;
-                *buf++ = ops[i].constant >> 56;
-                /* xor rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x31;
-                *buf++ = 0xf8;
-                break;
-            case HF64_MUL:
-                /* mov rdi, imm64 */
-                *buf++ = 0x48;
-                *buf++ = 0xbf;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
-                *buf++ = ops[i].constant >> 32;
-                *buf++ = ops[i].constant >> 40;
-                *buf++ = ops[i].constant >> 48;
-                *buf++ = ops[i].constant >> 56;
-                /* imul rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x0f;
-                *buf++ = 0xaf;
-                *buf++ = 0xc7;
-                break;
-            case HF64_ADD:
-                /* mov rdi, imm64 */
-                *buf++ = 0x48;
-                *buf++ = 0xbf;
-                *buf++ = ops[i].constant >>  0;
-                *buf++ = ops[i].constant >>  8;
-                *buf++ = ops[i].constant >> 16;
-                *buf++ = ops[i].constant >> 24;
-                *buf++ = ops[i].constant >> 32;
-                *buf++ = ops[i].constant >> 40;
-                *buf++ = ops[i].constant >> 48;
-                *buf++ = ops[i].constant >> 56;
-                /* add rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x01;
-                *buf++ = 0xf8;
-                break;
             case HF64_ROT:
-                /* rol rax, imm8 */
-                *buf++ = 0x48;
-                *buf++ = 0xc1;
-                *buf++ = 0xc0;
-                *buf++ = ops[i].constant;
-                break;
             case HF64_XORL:
-                /* mov edi, eax */
-                *buf++ = 0x48;
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl rdi, imm8 */
-                *buf++ = 0x48;
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* xor rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x31;
-                *buf++ = 0xf8;
-                break;
             case HF64_XORR:
-                /* mov rdi, rax */
-                *buf++ = 0x48;
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shr rdi, imm8 */
-                *buf++ = 0x48;
-                *buf++ = 0xc1;
-                *buf++ = 0xef;
-                *buf++ = ops[i].constant;
-                /* xor rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x31;
-                *buf++ = 0xf8;
-                break;
             case HF64_ADDL:
-                /* mov rdi, rax */
-                *buf++ = 0x48;
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl rdi, imm8 */
-                *buf++ = 0x48;
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* add rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x01;
-                *buf++ = 0xf8;
-                break;
             case HF64_SUBL:
-                /* mov rdi, rax */
-                *buf++ = 0x48;
-                *buf++ = 0x89;
-                *buf++ = 0xc7;
-                /* shl rdi, imm8 */
-                *buf++ = 0x48;
-                *buf++ = 0xc1;
-                *buf++ = 0xe7;
-                *buf++ = ops[i].constant;
-                /* sub rax, rdi */
-                *buf++ = 0x48;
-                *buf++ = 0x29;
-                *buf++ = 0xf8;
+                buf += sprintf(buf, ":%llu", c);
                 break;
         }
     }
-
-    /* ret */
-    *buf++ = 0xc3;
-    return buf;
-}
-
-static void *
-execbuf_alloc(void)
-{
-    int prot = PROT_READ | PROT_WRITE;
-    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
-    void *p = mmap(NULL, 4096, prot, flags, -1, 0);
-    if (p == MAP_FAILED) {
-        fprintf(stderr, "prospector: %s\n", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-    return p;
-}
-
-static enum {
-    WXR_UNKNOWN, WXR_ENABLED, WXR_DISABLED
-} wxr_enabled = WXR_UNKNOWN;
-
-static void
-execbuf_lock(void *buf)
-{
-    switch (wxr_enabled) {
-        case WXR_UNKNOWN:
-            if (!mprotect(buf, 4096, PROT_READ | PROT_WRITE | PROT_EXEC)) {
-                wxr_enabled = WXR_DISABLED;
-                return;
-            }
-            wxr_enabled = WXR_ENABLED;
-            /* FALLTHROUGH */
-        case WXR_ENABLED:
-            if (mprotect(buf, 4096, PROT_READ | PROT_EXEC)) {
-                fprintf(stderr,
-                        "prospector: mprotect(PROT_EXEC) failed: %s\n",
-                        strerror(errno));
-                exit(EXIT_FAILURE);
-            }
-            break;
-        case WXR_DISABLED:
-            break;
-    }
-}
-
-static void
-execbuf_unlock(void *buf)
-{
-    switch (wxr_enabled) {
-        case WXR_UNKNOWN:
-            abort();
-        case WXR_ENABLED:
-            mprotect(buf, 4096, PROT_READ | PROT_WRITE);
-            break;
-        case WXR_DISABLED:
-            break;
-    }
-}
-
-/* Higher quality is slower but has more consistent results. */
-static int score_quality = 18;
-
-/* Measures how each input bit affects each output bit. This measures
- * both bias and avalanche.
- */
-static double
-estimate_bias32(uint32_t ABI (*f)(uint32_t), uint64_t rng[2])
-{
-    long n = 1L << score_quality;
-    long bins[32][32] = {{0}};
-    for (long i = 0; i < n; i++) {
-        uint32_t x = xoroshiro128plus(rng);
-        uint32_t h0 = f(x);
-        for (int j = 0; j < 32; j++) {
-            uint32_t bit = UINT32_C(1) << j;
-            uint32_t h1 = f(x ^ bit);
-            uint32_t set = h0 ^ h1;
-            for (int k = 0; k < 32; k++)
-                bins[j][k] += (set >> k) & 1;
-        }
-    }
-    double mean = 0;
-    for (int j = 0; j < 32; j++) {
-        for (int k = 0; k < 32; k++) {
-            /* FIXME: normalize this somehow */
-            double diff = (bins[j][k] - n / 2) / (n / 2.0);
-            mean += (diff * diff) / (32 * 32);
-        }
-    }
-    return sqrt(mean) * 1000.0;
-}
-
-static double
-estimate_bias64(uint64_t ABI (*f)(uint64_t), uint64_t rng[2])
-{
-    long n = 1L << score_quality;
-    long bins[64][64] = {{0}};
-    for (long i = 0; i < n; i++) {
-        uint64_t x = xoroshiro128plus(rng);
-        uint64_t h0 = f(x);
-        for (int j = 0; j < 64; j++) {
-            uint64_t bit = UINT64_C(1) << j;
-            uint64_t h1 = f(x ^ bit);
-            uint64_t set = h0 ^ h1;
-            for (int k = 0; k < 64; k++)
-                bins[j][k] += (set >> k) & 1;
-        }
-    }
-    double mean = 0;
-    for (int j = 0; j < 64; j++) {
-        for (int k = 0; k < 64; k++) {
-            /* FIXME: normalize this somehow */
-            double diff = (bins[j][k] - n / 2) / (n / 2.0);
-            mean += (diff * diff) / (64 * 64);
-        }
-    }
-    return sqrt(mean) * 1000.0;
-}
-
-#define EXACT_SPLIT 32  // must be power of two
-static double
-exact_bias32(uint32_t ABI (*f)(uint32_t))
-{
-    long long bins[32][32] = {{0}};
-    static const uint64_t range = (UINT64_C(1) << 32) / EXACT_SPLIT;
-    #pragma omp parallel for
-    for (int i = 0; i < EXACT_SPLIT; i++) {
-        long long b[32][32] = {{0}};
-        for (uint64_t x = i * range; x < (i + 1) * range; x++) {
-            uint32_t h0 = f(x);
-            for (int j = 0; j < 32; j++) {
-                uint32_t bit = UINT32_C(1) << j;
-                uint32_t h1 = f(x ^ bit);
-                uint32_t set = h0 ^ h1;
-                for (int k = 0; k < 32; k++)
-                    b[j][k] += (set >> k) & 1;
-            }
-        }
-        #pragma omp critical
-        for (int j = 0; j < 32; j++)
-            for (int k = 0; k < 32; k++)
-                bins[j][k] += b[j][k];
-    }
-    double mean = 0.0;
-    for (int j = 0; j < 32; j++) {
-        for (int k = 0; k < 32; k++) {
-            double diff = (bins[j][k] - 2147483648L) / 2147483648.0;
-            mean += (diff * diff) / (32 * 32);
-        }
-    }
-    return sqrt(mean) * 1000.0;
-}
-
-static void
-usage(FILE *f)
-{
-    fprintf(f, "usage: prospector "
-            "[-E|L|S] [-4|-8] [-ehs] [-l lib] [-p pattern] [-r n:m] [-t x]\n");
-    fprintf(f, " -4          Generate 32-bit hash functions (default)\n");
-    fprintf(f, " -8          Generate 64-bit hash functions\n");
-    fprintf(f, " -e          Measure bias exactly (requires -E)\n");
-    fprintf(f, " -h          Print this help message\n");
-    fprintf(f, " -l ./lib.so Load hash() from a shared object\n");
-    fprintf(f, " -p pattern  Search only a given pattern\n");
-    fprintf(f, " -q n        Score quality knob (12-30, default: 18)\n");
-    fprintf(f, " -r n:m      Use between n and m operations [3:6]\n");
-    fprintf(f, " -s          Don't use large constants\n");
-    fprintf(f, " -t x        Initial score threshold [10.0]\n");
-    fprintf(f, " -E          Single evaluation mode (requires -p or -l)\n");
-    fprintf(f, " -S          Hash function search mode (default)\n");
-    fprintf(f, " -L          Enumerate output mode (requires -p or -l)\n");
+    *buf = 0;
 }
 
 static int
@@ -695,13 +455,21 @@ parse_operand(struct hf_op *op, char *buf)
         case HF64_NOT:
         case HF32_BSWAP:
         case HF64_BSWAP:
+        case HF32_CRC:
+        case HF64_CRC:
+        case HF32_AES:
+        case HF64_AES:
             return 0;
         case HF32_XOR:
         case HF32_MUL:
         case HF32_ADD:
+        case HF32_CLMUL:
+        case HF32_PEXT:
         case HF64_XOR:
         case HF64_MUL:
         case HF64_ADD:
+        case HF64_CLMUL:
+        case HF64_PEXT:
             op->constant = strtoull(buf, 0, 16);
             return 1;
         case HF32_ROT:
@@ -749,74 +517,4239 @@ parse_template(struct hf_op *ops, int n, char *template, int flags)
     return c;
 }
 
-static void *
-load_function(const char *so)
+/* Return 1 if both functions have identical operations.
+ */
+static int
+hf_same(const struct hf_op *a, int na, const struct hf_op *b, int nb)
 {
-    void *handle = dlopen(so, RTLD_NOW);
-    if (!handle) {
-        fprintf(stderr, "prospector: could not load %s\n", so);
-        exit(EXIT_FAILURE);
-    }
-    void *f = dlsym(handle, "hash");
-    if (!f) {
-        fprintf(stderr, "prospector: could not find 'hash' in %s\n", so);
-        exit(EXIT_FAILURE);
-    }
-    return f;
+    if (na != nb)
+        return 0;
+    for (int i = 0; i < na; i++)
+        if (a[i].type != b[i].type || a[i].constant != b[i].constant)
+            return 0;
+    return 1;
 }
 
-static uint64_t
-uepoch(void)
+/* Return 1 if this CPU has the instructions compiled for a type.
+ */
+static int
+hf_supported(enum hf_type type)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return 1000000LL * tv.tv_sec + tv.tv_usec;
+    switch (type) {
+        case HF32_CRC:
+        case HF64_CRC:
+            return __builtin_cpu_supports("sse4.2");
+        case HF32_AES:
+        case HF64_AES:
+            return __builtin_cpu_supports("aes");
+        case HF32_CLMUL:
+        case HF64_CLMUL:
+            return __builtin_cpu_supports("pclmul");
+        case HF32_PEXT:
+        case HF64_PEXT:
+            return __builtin_cpu_supports("bmi2");
+        default:
+            return 1;
+    }
 }
 
-int
-main(int argc, char **argv)
+/* Latency cost model: nanoseconds added by each operation type, and
+ * the cost of calling an empty function. Calibrated on this machine at
+ * startup by hf_calibrate().
+ */
+static double hf_costs[HF64_PEXT + 1];
+static double hf_overhead;
+
+/* Estimated latency of a function in nanoseconds.
+ */
+static double
+hf_latency(const struct hf_op *ops, int n)
 {
-    int nops = 0;
-    int min = 3;
-    int max = 6;
-    int flags = 0;
-    int use_exact = 0;
-    double best = 100.0;
-    char *dynamic = 0;
-    char *template = 0;
-    struct hf_op ops[32];
-    void *buf = execbuf_alloc();
-    uint64_t rng[2] = {0x2a2bc037b59ff989, 0x6d7db86fa2f632ca};
+    double latency = hf_overhead;
+    for (int i = 0; i < n; i++)
+        latency += hf_costs[ops[i].type];
+    return latency;
+}
 
-    enum {MODE_SEARCH, MODE_EVAL, MODE_LIST} mode = MODE_SEARCH;
+/* Set by main() if the CPU supports BMI2 (rorx). */
+static int hf_bmi2;
 
-    int option;
-    while ((option = getopt(argc, argv, "48EehLl:q:r:st:p:")) != -1) {
-        switch (option) {
-            case '4':
-                flags &= ~F_U64;
-                break;
-            case '8':
-                flags |= F_U64;
-                break;
+/* Set when functions are interpreted rather than JIT compiled, either
+ * by request or because executable memory is unavailable.
+ */
+static int hf_interpret;
+
+/* Independent inputs hashed by each call to a batched function, or 1 to
+ * score one input per call.
+ */
+static int hf_lanes = 8;
+
+/* Worst-case machine code sizes in bytes: one operation on one value
+ * (64-bit pext), and loading a large constant. With at most 32
+ * operations, a function fits below BATCH_OFFSET, and its batched
+ * version at 8 lanes fits in BATCH_MAX.
+ */
+#define HF_OP_MAX     40
+#define HF_IMM_MAX    10
+#define BATCH_OFFSET  2048  // batched function's place in an execbuf
+#define BATCH_MAX     (64 + 32 * (HF_IMM_MAX + 8 * HF_OP_MAX))
+#define EXECBUF_SIZE  ((BATCH_OFFSET + BATCH_MAX + 4095) & -4096)
+
+enum {
+    REG_AX, REG_CX, REG_DX, REG_BX, REG_SP, REG_BP, REG_SI, REG_DI,
+    REG_R8, REG_R9, REG_R10, REG_R11
+};
+
+#define MODRM(reg, rm) (0xc0 | ((reg) & 7) << 3 | ((rm) & 7))
+
+/* Emit a REX prefix, if one is needed, for an instruction of the given
+ * width (1 for 64 bits) whose ModRM names registers reg and rm.
+ */
+static unsigned char *
+hf_rex(unsigned char *buf, int w, int reg, int rm)
+{
+    int rex = 0x40 | w << 3 | (reg >> 3) << 2 | rm >> 3;
+    if (rex != 0x40)
+        *buf++ = rex;
+    return buf;
+}
+
+/* Return 1 if v survives sign extension from the given number of bits,
+ * truncated to the width of the operation.
+ */
+static int
+hf_fits(uint64_t v, int bits, int u64)
+{
+    uint64_t mask = u64 ? ~UINT64_C(0) : 0xffffffff;
+    uint64_t ext = (uint64_t)((int64_t)(v << (64 - bits)) >> (64 - bits));
+    return ((ext ^ v) & mask) == 0;
+}
+
+/* Return 1 if the operation's constant must be loaded into a register:
+ * a 64-bit constant that is not a sign-extended imm32, or any clmul
+ * constant, which goes to an XMM register through one.
+ */
+static int
+hf_bigconst(const struct hf_op *op)
+{
+    switch (op->type) {
+        case HF64_XOR:
+        case HF64_MUL:
+        case HF64_ADD:
+            return !hf_fits(op->constant, 32, 1);
+        case HF32_CLMUL:
+        case HF64_CLMUL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static unsigned char *
+hf_imm32(unsigned char *buf, uint64_t v)
+{
+    *buf++ = v >>  0;
+    *buf++ = v >>  8;
+    *buf++ = v >> 16;
+    *buf++ = v >> 24;
+    return buf;
+}
+
+/* Emit mov r, imm, using the zero-extending imm32 form if it fits.
+ */
+static unsigned char *
+hf_movimm(unsigned char *buf, int r, uint64_t v)
+{
+    buf = hf_rex(buf, v >> 32 != 0, 0, r);
+    *buf++ = 0xb8 + (r & 7);
+    buf = hf_imm32(buf, v);
+    if (v >> 32)
+        buf = hf_imm32(buf, v >> 32);
+    return buf;
+}
+
+/* Emit an SSE instruction 66 [REX] 0F op /r with an optional second
+ * opcode byte (op2, for the 0F 38 and 0F 3A maps) on XMM or general
+ * registers reg and rm.
+ */
+static unsigned char *
+hf_sse(unsigned char *buf, int w, int op, int op2, int reg, int rm)
+{
+    *buf++ = 0x66;
+    buf = hf_rex(buf, w, reg, rm);
+    *buf++ = 0x0f;
+    *buf++ = op;
+    if (op2)
+        *buf++ = op2;
+    *buf++ = MODRM(reg, rm);
+    return buf;
+}
+
+/* Emit pext d, s, m (BMI2).
+ */
+static unsigned char *
+hf_pext(unsigned char *buf, int w, int d, int s, int m)
+{
+    *buf++ = 0xc4;
+    *buf++ = 0xe2 ^ (d >> 3) << 7 ^ (m >> 3) << 5;  // VEX.~R, VEX.~B
+    *buf++ = w << 7 | (~s & 15) << 3 | 0x02;       // VEX.W, VEX.~vvvv, F3
+    *buf++ = 0xf5;
+    *buf++ = MODRM(d, m);
+    return buf;
+}
+
+/* Emit op x, imm with the shortest available encoding, where ext is the
+ * ModRM extension of the 0x81/0x83 group (0 = add, 6 = xor) and op is
+ * the register form's opcode, used with big constants held in k.
+ */
+static unsigned char *
+hf_arith(unsigned char *buf, int w, int ext, int op, int x, int k,
+         uint64_t v)
+{
+    if (w && !hf_fits(v, 32, 1)) {
+        /* op x, k */
+        buf = hf_rex(buf, w, k, x);
+        *buf++ = op;
+        *buf++ = MODRM(k, x);
+        return buf;
+    }
+    buf = hf_rex(buf, w, 0, x);
+    if (hf_fits(v, 8, w)) {
+        /* op x, imm8 */
+        *buf++ = 0x83;
+        *buf++ = MODRM(ext, x);
+        *buf++ = v;
+    } else if (x == REG_AX) {
+        /* op eax, imm32 */
+        *buf++ = ext << 3 | 0x05;
+        buf = hf_imm32(buf, v);
+    } else {
+        /* op x, imm32 */
+        *buf++ = 0x81;
+        *buf++ = MODRM(ext, x);
+        buf = hf_imm32(buf, v);
+    }
+    return buf;
+}
+
+/* Emit one operation on the value in register *x, with *t and k as
+ * scratch, and xmm0 and xmm1 for the SSE operations. A big constant
+ * (hf_bigconst) must already be loaded into k. If swap is set,
+ * x ^= x >> n and friends combine into the shifted copy, which saves a
+ * move but leaves the value in *t, so the two are exchanged.
+ */
+static unsigned char *
+hf_emit(unsigned char *buf, const struct hf_op *op, int w, int *x, int *t,
+        int k, int swap)
+{
+    int r = *x;
+    int s = *t;
+    uint64_t c = op->constant;
+    uint64_t mask = w ? UINT64_MAX : 0xffffffff;
+    int pop;
+    switch (op->type) {
+        case HF32_NOT:
+        case HF64_NOT:
+            /* not x */
+            buf = hf_rex(buf, w, 0, r);
+            *buf++ = 0xf7;
+            *buf++ = MODRM(2, r);
+            break;
+        case HF32_BSWAP:
+        case HF64_BSWAP:
+            /* bswap x */
+            buf = hf_rex(buf, w, 0, r);
+            *buf++ = 0x0f;
+            *buf++ = 0xc8 + (r & 7);
+            break;
+        case HF32_XOR:
+        case HF64_XOR:
+            /* xor x, imm */
+            buf = hf_arith(buf, w, 6, 0x31, r, k, c);
+            break;
+        case HF32_ADD:
+        case HF64_ADD:
+            /* add x, imm */
+            buf = hf_arith(buf, w, 0, 0x01, r, k, c);
+            break;
+        case HF32_MUL:
+        case HF64_MUL:
+            if (w && !hf_fits(c, 32, 1)) {
+                /* imul x, k */
+                buf = hf_rex(buf, w, r, k);
+                *buf++ = 0x0f;
+                *buf++ = 0xaf;
+                *buf++ = MODRM(r, k);
+            } else if (hf_fits(c, 8, w)) {
+                /* imul x, x, imm8 */
+                buf = hf_rex(buf, w, r, r);
+                *buf++ = 0x6b;
+                *buf++ = MODRM(r, r);
+                *buf++ = c;
+            } else {
+                /* imul x, x, imm32 */
+                buf = hf_rex(buf, w, r, r);
+                *buf++ = 0x69;
+                *buf++ = MODRM(r, r);
+                buf = hf_imm32(buf, c);
+            }
+            break;
+        case HF32_ROT:
+        case HF64_ROT:
+            if (hf_bmi2) {
+                /* rorx x, x, bits - imm8 */
+                *buf++ = 0xc4;
+                *buf++ = 0xe3 ^ (r >> 3) * 0xa0;  // VEX.~R and VEX.~B
+                *buf++ = w ? 0xfb : 0x7b;
+                *buf++ = 0xf0;
+                *buf++ = MODRM(r, r);
+                *buf++ = (w ? 64 : 32) - c;
+            } else {
+                /* rol x, imm8 */
+                buf = hf_rex(buf, w, 0, r);
+                *buf++ = 0xc1;
+                *buf++ = MODRM(0, r);
+                *buf++ = c;
+            }
+            break;
+        case HF32_ADDL:
+        case HF64_ADDL:
+            if (c <= 3) {
+                /* lea x, [x + x*(1 << imm)] */
+                int rex = 0x40 | w << 3 | (r >> 3) * 7;  // REX.RXB
+                if (rex != 0x40)
+                    *buf++ = rex;
+                *buf++ = 0x8d;
+                *buf++ = 0x04 | (r & 7) << 3;
+                *buf++ = c << 6 | (r & 7) << 3 | (r & 7);
+                break;
+            }
+            /* fallthrough */
+        case HF32_XORL:
+        case HF64_XORL:
+        case HF32_XORR:
+        case HF64_XORR:
+        case HF32_SUBL:
+        case HF64_SUBL:
+            /* mov t, x */
+            buf = hf_rex(buf, w, r, s);
+            *buf++ = 0x89;
+            *buf++ = MODRM(r, s);
+            /* shl/shr t, imm8 */
+            buf = hf_rex(buf, w, 0, s);
+            *buf++ = 0xc1;
+            *buf++ = MODRM(op->type == HF32_XORR ||
+                           op->type == HF64_XORR ? 5 : 4, s);
+            *buf++ = c;
+            int opcode;
+            switch (op->type) {
+                case HF32_XORL:
+                case HF64_XORL:
+                case HF32_XORR:
+                case HF64_XORR:
+                    opcode = 0x31;
+                    break;
+                case HF32_ADDL:
+                case HF64_ADDL:
+                    opcode = 0x01;
+                    break;
+                default:
+                    /* sub x, t */
+                    buf = hf_rex(buf, w, s, r);
+                    *buf++ = 0x29;
+                    *buf++ = MODRM(s, r);
+                    return buf;
+            }
+            if (swap) {
+                /* xor/add t, x */
+                buf = hf_rex(buf, w, r, s);
+                *buf++ = opcode;
+                *buf++ = MODRM(r, s);
+                *x = s;
+                *t = r;
+            } else {
+                /* xor/add x, t */
+                buf = hf_rex(buf, w, s, r);
+                *buf++ = opcode;
+                *buf++ = MODRM(s, r);
+            }
+            break;
+        case HF32_CRC:
+        case HF64_CRC:
+            if (w) {
+                /* mov t, x; shr t, 32 */
+                buf = hf_rex(buf, 1, r, s);
+                *buf++ = 0x89;
+                *buf++ = MODRM(r, s);
+                buf = hf_rex(buf, 1, 0, s);
+                *buf++ = 0xc1;
+                *buf++ = MODRM(5, s);
+                *buf++ = 32;
+            } else {
+                s = r;
+            }
+            /* xor k, k */
+            buf = hf_rex(buf, 0, k, k);
+            *buf++ = 0x31;
+            *buf++ = MODRM(k, k);
+            /* crc32 t, k: crc32c(t, 0) == crc32c(0, t) */
+            *buf++ = 0xf2;
+            buf = hf_rex(buf, 0, s, k);
+            *buf++ = 0x0f;
+            *buf++ = 0x38;
+            *buf++ = 0xf1;
+            *buf++ = MODRM(s, k);
+            if (w) {
+                /* xor x, t */
+                buf = hf_rex(buf, 1, s, r);
+                *buf++ = 0x31;
+                *buf++ = MODRM(s, r);
+            }
+            break;
+        case HF32_AES:
+        case HF64_AES:
+            /* movd/movq xmm0, x */
+            buf = hf_sse(buf, w, 0x6e, 0, 0, r);
+            if (w) {
+                /* punpcklqdq xmm0, xmm0 */
+                buf = hf_sse(buf, 0, 0x6c, 0, 0, 0);
+            } else {
+                /* pshufd xmm0, xmm0, 0 */
+                buf = hf_sse(buf, 0, 0x70, 0, 0, 0);
+                *buf++ = 0;
+            }
+            /* pxor xmm1, xmm1 */
+            buf = hf_sse(buf, 0, 0xef, 0, 1, 1);
+            /* aesenc xmm0, xmm1 */
+            buf = hf_sse(buf, 0, 0x38, 0xdc, 0, 1);
+            /* movd/movq x, xmm0 */
+            buf = hf_sse(buf, w, 0x7e, 0, 0, r);
+            break;
+        case HF32_CLMUL:
+        case HF64_CLMUL:
+            /* movd/movq xmm0, x */
+            buf = hf_sse(buf, w, 0x6e, 0, 0, r);
+            /* movd/movq xmm1, k */
+            buf = hf_sse(buf, w, 0x6e, 0, 1, k);
+            /* pclmulqdq xmm0, xmm1, 0 */
+            buf = hf_sse(buf, 0, 0x3a, 0x44, 0, 1);
+            *buf++ = 0;
+            /* movd/movq x, xmm0 */
+            buf = hf_sse(buf, w, 0x7e, 0, 0, r);
+            break;
+        case HF32_PEXT:
+        case HF64_PEXT:
+            /* Load the masks per lane, since k is shared in batches */
+            pop = __builtin_popcountll(c & mask);
+            /* t = pext(x, ~m) << popcount(m) */
+            buf = hf_movimm(buf, s, ~c & mask);
+            buf = hf_pext(buf, w, s, r, s);
+            if (pop && pop < (w ? 64 : 32)) {
+                buf = hf_rex(buf, w, 0, s);
+                *buf++ = 0xc1;
+                *buf++ = MODRM(4, s);
+                *buf++ = pop;
+            }
+            /* x = pext(x, m) | t */
+            buf = hf_movimm(buf, k, c & mask);
+            buf = hf_pext(buf, w, r, r, k);
+            buf = hf_rex(buf, w, s, r);
+            *buf++ = 0x09;
+            *buf++ = MODRM(s, r);
+            break;
+    }
+    return buf;
+}
+
+/* Without executable memory, "compiled" functions are instead programs
+ * for the interpreter, hf_run32() and hf_run64().
+ */
+struct hf_prog {
+    int n;
+    struct hf_op ops[32];
+};
+
+static uint32_t
+crc32c_word(uint32_t x)
+{
+    for (int i = 0; i < 32; i++)
+        x = x >> 1 ^ (0x82f63b78 & -(x & 1));
+    return x;
+}
+
+static const unsigned char aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16,
+};
+
+/* SubBytes then MixColumns on one AES column, row 0 in the low byte.
+ */
+static uint32_t
+aes_column(uint32_t x)
+{
+    unsigned a[4], d[4];
+    for (int i = 0; i < 4; i++) {
+        a[i] = aes_sbox[x >> (8 * i) & 0xff];
+        d[i] = (a[i] << 1 ^ (a[i] >> 7) * 0x1b) & 0xff;  // a * 2
+    }
+    return (uint32_t)(d[0] ^ d[1] ^ a[1] ^ a[2] ^ a[3]) <<  0 |
+           (uint32_t)(a[0] ^ d[1] ^ d[2] ^ a[2] ^ a[3]) <<  8 |
+           (uint32_t)(a[0] ^ a[1] ^ d[2] ^ d[3] ^ a[3]) << 16 |
+           (uint32_t)(d[0] ^ a[0] ^ a[1] ^ a[2] ^ d[3]) << 24;
+}
+
+/* Low 64 bits of an AES round (zero key) of x broadcast to both
+ * halves, where ShiftRows exchanges the odd rows between the halves.
+ */
+static uint64_t
+aes_word64(uint64_t x)
+{
+    uint32_t lo = x;
+    uint32_t hi = x >> 32;
+    uint32_t c0 = (lo & 0x00ff00ff) | (hi & 0xff00ff00);
+    uint32_t c1 = (hi & 0x00ff00ff) | (lo & 0xff00ff00);
+    return aes_column(c0) | (uint64_t)aes_column(c1) << 32;
+}
+
+static uint64_t
+clmul_word(uint64_t x, uint64_t c)
+{
+    uint64_t r = 0;
+    for (int i = 0; i < 64; i++)
+        r ^= x << i & -(c >> i & 1);
+    return r;
+}
+
+static uint64_t
+pext_word(uint64_t x, uint64_t m)
+{
+    uint64_t r = 0;
+    for (int n = 0; m; m &= m - 1, n++)
+        r |= (x >> __builtin_ctzll(m) & 1) << n;
+    return r;
+}
+
+/* Apply a program to len values in place. Dispatch happens once per
+ * operation rather than per value, and each operation's loop is simple
+ * enough for the compiler to vectorize.
+ */
+static void
+hf_run32(const struct hf_prog *p, uint32_t *v, int len)
+{
+    for (int i = 0; i < p->n; i++) {
+        uint32_t c = p->ops[i].constant;
+        int pop = __builtin_popcount(c);
+        switch (p->ops[i].type) {
+            case HF32_XOR:
+                for (int j = 0; j < len; j++) v[j] ^= c;
+                break;
+            case HF32_MUL:
+                for (int j = 0; j < len; j++) v[j] *= c;
+                break;
+            case HF32_ADD:
+                for (int j = 0; j < len; j++) v[j] += c;
+                break;
+            case HF32_ROT:
+                for (int j = 0; j < len; j++)
+                    v[j] = v[j] << c | v[j] >> (-c & 31);
+                break;
+            case HF32_NOT:
+                for (int j = 0; j < len; j++) v[j] = ~v[j];
+                break;
+            case HF32_BSWAP:
+                for (int j = 0; j < len; j++) v[j] = __builtin_bswap32(v[j]);
+                break;
+            case HF32_XORL:
+                for (int j = 0; j < len; j++) v[j] ^= v[j] << c;
+                break;
+            case HF32_XORR:
+                for (int j = 0; j < len; j++) v[j] ^= v[j] >> c;
+                break;
+            case HF32_ADDL:
+                for (int j = 0; j < len; j++) v[j] += v[j] << c;
+                break;
+            case HF32_SUBL:
+                for (int j = 0; j < len; j++) v[j] -= v[j] << c;
+                break;
+            case HF32_CRC:
+                for (int j = 0; j < len; j++) v[j] = crc32c_word(v[j]);
+                break;
+            case HF32_AES:
+                for (int j = 0; j < len; j++) v[j] = aes_column(v[j]);
+                break;
+            case HF32_CLMUL:
+                for (int j = 0; j < len; j++) v[j] = clmul_word(v[j], c);
+                break;
+            case HF32_PEXT:
+                for (int j = 0; j < len; j++)
+                    v[j] = pext_word(v[j], c) |
+                           (uint64_t)pext_word(v[j], ~c) << pop;
+                break;
+            default:
+                abort();
+        }
+    }
+}
+
+static void
+hf_run64(const struct hf_prog *p, uint64_t *v, int len)
+{
+    for (int i = 0; i < p->n; i++) {
+        uint64_t c = p->ops[i].constant;
+        int pop = __builtin_popcountll(c);
+        switch (p->ops[i].type) {
+            case HF64_XOR:
+                for (int j = 0; j < len; j++) v[j] ^= c;
+                break;
+            case HF64_MUL:
+                for (int j = 0; j < len; j++) v[j] *= c;
+                break;
+            case HF64_ADD:
+                for (int j = 0; j < len; j++) v[j] += c;
+                break;
+            case HF64_ROT:
+                for (int j = 0; j < len; j++)
+                    v[j] = v[j] << c | v[j] >> (-c & 63);
+                break;
+            case HF64_NOT:
+                for (int j = 0; j < len; j++) v[j] = ~v[j];
+                break;
+            case HF64_BSWAP:
+                for (int j = 0; j < len; j++) v[j] = __builtin_bswap64(v[j]);
+                break;
+            case HF64_XORL:
+                for (int j = 0; j < len; j++) v[j] ^= v[j] << c;
+                break;
+            case HF64_XORR:
+                for (int j = 0; j < len; j++) v[j] ^= v[j] >> c;
+                break;
+            case HF64_ADDL:
+                for (int j = 0; j < len; j++) v[j] += v[j] << c;
+                break;
+            case HF64_SUBL:
+                for (int j = 0; j < len; j++) v[j] -= v[j] << c;
+                break;
+            case HF64_CRC:
+                for (int j = 0; j < len; j++) v[j] ^= crc32c_word(v[j] >> 32);
+                break;
+            case HF64_AES:
+                for (int j = 0; j < len; j++) v[j] = aes_word64(v[j]);
+                break;
+            case HF64_CLMUL:
+                for (int j = 0; j < len; j++) v[j] = clmul_word(v[j], c);
+                break;
+            case HF64_PEXT:
+                for (int j = 0; j < len; j++)
+                    v[j] = pext_word(v[j], c) |
+                           (pop < 64 ? pext_word(v[j], ~c) << pop : 0);
+                break;
+            default:
+                abort();
+        }
+    }
+}
+
+/* Compile a function hashing hf_lanes inputs in place through a
+ * pointer, with each lane in its own register. Each operation is
+ * applied to every lane before the next, so the CPU overlaps the lanes'
+ * otherwise serial dependency chains, hiding multiply latency.
+ */
+static void
+hf_compile_batch(const struct hf_op *ops, int n, unsigned char *buf)
+{
+    static const unsigned char lanes[] = {
+        REG_AX, REG_CX, REG_DX, REG_SI, REG_R8, REG_R9, REG_R10, REG_R11
+    };
+    int w = n && ops[0].type >= HF64_XOR;
+    int size = w ? 8 : 4;
+
+    /* push rbx; push rbp */
+    *buf++ = 0x53;
+    *buf++ = 0x55;
+    for (int i = 0; i < hf_lanes; i++) {
+        /* mov x, [rdi + i*size] */
+        buf = hf_rex(buf, w, lanes[i], REG_DI);
+        *buf++ = 0x8b;
+        *buf++ = 0x40 | (lanes[i] & 7) << 3 | REG_DI;
+        *buf++ = i * size;
+    }
+    for (int j = 0; j < n; j++) {
+        if (hf_bigconst(ops + j))
+            buf = hf_movimm(buf, REG_BP, ops[j].constant);
+        for (int i = 0; i < hf_lanes; i++) {
+            int x = lanes[i];
+            int t = REG_BX;
+            buf = hf_emit(buf, ops + j, w, &x, &t, REG_BP, 0);
+        }
+    }
+    for (int i = 0; i < hf_lanes; i++) {
+        /* mov [rdi + i*size], x */
+        buf = hf_rex(buf, w, lanes[i], REG_DI);
+        *buf++ = 0x89;
+        *buf++ = 0x40 | (lanes[i] & 7) << 3 | REG_DI;
+        *buf++ = i * size;
+    }
+    /* pop rbp; pop rbx; ret */
+    *buf++ = 0x5d;
+    *buf++ = 0x5b;
+    *buf++ = 0xc3;
+}
+
+/* Compile a function to x86-64 machine code in an execbuf, with the
+ * batched version (if hf_lanes > 1) at BATCH_OFFSET.
+ *
+ * The value lives in either edi or eax, whichever saves a move: for
+ * x ^= x >> n the shifted copy is combined in place, after which the
+ * copy holds the value and the old register becomes scratch. Small
+ * constants use the short immediate encodings, x += x << {1,2,3}
+ * becomes a lea, and rotations use BMI2's rorx when available. The
+ * value is moved into eax at the end only if it is not already there.
+ */
+static unsigned char *
+hf_compile(const struct hf_op *ops, int n, unsigned char *buf)
+{
+    int w = n && ops[0].type >= HF64_XOR;
+    int x = REG_DI;  // holds the value
+    int t = REG_AX;  // scratch
+    int k = REG_DX;  // constants
+
+    if (hf_interpret) {
+        struct hf_prog *p = (struct hf_prog *)buf;
+        p->n = n;
+        memcpy(p->ops, ops, n * sizeof(*ops));
+        return buf + sizeof(*p);
+    }
+    if (hf_lanes > 1)
+        hf_compile_batch(ops, n, buf + BATCH_OFFSET);
+    for (int i = 0; i < n; i++) {
+        if (hf_bigconst(ops + i))
+            buf = hf_movimm(buf, k, ops[i].constant);
+        buf = hf_emit(buf, ops + i, w, &x, &t, k, 1);
+    }
+    if (x != REG_AX) {
+        /* mov eax, x */
+        buf = hf_rex(buf, w, x, REG_AX);
+        *buf++ = 0x89;
+        *buf++ = MODRM(x, REG_AX);
+    }
+    /* ret */
+    *buf++ = 0xc3;
+    return buf;
+}
+
+/* Return the batched version of a function compiled into buf, or null
+ * if batching is disabled. When interpreting, this is the program.
+ */
+static void *
+hf_batch(void *buf)
+{
+    if (hf_interpret)
+        return buf;
+    return hf_lanes > 1 ? (unsigned char *)buf + BATCH_OFFSET : 0;
+}
+
+static enum {
+    WXR_UNKNOWN, WXR_ENABLED, WXR_DISABLED, WXR_NOEXEC
+} wxr_enabled = WXR_UNKNOWN;
+
+static void *
+execbuf_alloc(void)
+{
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (wxr_enabled == WXR_DISABLED)
+        prot |= PROT_EXEC;
+    void *p = mmap(NULL, EXECBUF_SIZE, prot, flags, -1, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "prospector: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void
+execbuf_lock(void *buf)
+{
+    int rwx = PROT_READ | PROT_WRITE | PROT_EXEC;
+    switch (wxr_enabled) {
+        case WXR_UNKNOWN:
+            if (!mprotect(buf, EXECBUF_SIZE, rwx)) {
+                wxr_enabled = WXR_DISABLED;
+                return;
+            }
+            if (mprotect(buf, EXECBUF_SIZE, PROT_READ | PROT_EXEC)) {
+                fprintf(stderr, "prospector: executable memory "
+                        "unavailable, using the interpreter\n");
+                mprotect(buf, EXECBUF_SIZE, PROT_READ | PROT_WRITE);
+                wxr_enabled = WXR_NOEXEC;
+                hf_interpret = 1;
+                return;
+            }
+            wxr_enabled = WXR_ENABLED;
+            break;
+        case WXR_ENABLED:
+            if (mprotect(buf, EXECBUF_SIZE, PROT_READ | PROT_EXEC)) {
+                fprintf(stderr,
+                        "prospector: mprotect(PROT_EXEC) failed: %s\n",
+                        strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case WXR_DISABLED:
+        case WXR_NOEXEC:
+            break;
+    }
+}
+
+static void
+execbuf_unlock(void *buf)
+{
+    switch (wxr_enabled) {
+        case WXR_UNKNOWN:
+            abort();
+        case WXR_ENABLED:
+            mprotect(buf, EXECBUF_SIZE, PROT_READ | PROT_WRITE);
+            break;
+        case WXR_DISABLED:
+        case WXR_NOEXEC:
+            break;
+    }
+}
+
+/* Set asynchronously to make exact_run() and the estimates abandon
+ * their remaining chunks.
+ */
+static volatile sig_atomic_t exact_cancel;
+
+/* Higher quality is slower but has more consistent results. */
+static int score_quality = 18;
+
+/* Counter-based sample generator. Sample i of a stream is a pure
+ * function of (seed, i), so any range of samples can be generated
+ * independently and in any order, by any thread or SIMD lane, and an
+ * estimate is reproducible no matter how its samples are divided.
+ */
+static uint64_t
+sample64(uint64_t seed, uint64_t i)
+{
+    uint64_t x = seed + i * 0x9e3779b97f4a7c15;
+    x ^= x >> 27;
+    x *= 0x3c79ac492ba7b653;
+    x ^= x >> 33;
+    x *= 0x1c69b3f74ac4ae35;
+    x ^= x >> 27;
+    return x;
+}
+
+#define SAMPLE_BLOCK 256  // samples generated per batch
+
+/* Keys mapped from a file (-K), as native-endian words of the function
+ * width. When present, estimates draw their inputs from these keys
+ * rather than generating uniformly random inputs.
+ */
+static const void *keys;
+static long nkeys;
+
+/* Load keys from a file, mapped read-only and prefaulted so that
+ * threads can read them directly.
+ */
+static void
+keys_load(const char *path, int bits)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st)) {
+        fprintf(stderr, "prospector: %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    long width = bits / 8;
+    if (!st.st_size || st.st_size % width) {
+        fprintf(stderr, "prospector: %s: not a whole number of %d-bit "
+                "keys\n", path, bits);
+        exit(EXIT_FAILURE);
+    }
+    void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "prospector: %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    keys = p;
+    nkeys = st.st_size / width;
+}
+
+/* Number of samples for an estimate that wants n: every key once if
+ * there are no more than n keys.
+ */
+static long
+keys_samples(long n)
+{
+    return nkeys && nkeys < n ? nkeys : n;
+}
+
+/* FNV-1a over the keys, identifying them in search checkpoints. */
+static uint64_t
+keys_hash(int bits)
+{
+    const unsigned char *p = keys;
+    uint64_t h = 0xcbf29ce484222325;
+    for (long i = 0; i < nkeys * (bits / 8); i++)
+        h = (h ^ p[i]) * 0x100000001b3;
+    return h;
+}
+
+/* Input for sample i of an estimate over n samples. With keys, they're
+ * divided into n nearly equal strata in file order, and sample i is
+ * drawn from stratum i, so even a small subsample of a huge trace
+ * covers all of it. With as many samples as keys, sample i is key i.
+ */
+static uint64_t
+sample_input(uint64_t seed, long i, long n, int bits)
+{
+    if (!nkeys)
+        return sample64(seed, i);
+    long q = nkeys / n;
+    long r = nkeys % n;
+    long k = i * q + (i < r ? i : r);
+    long size = q + (i < r);
+    if (size > 1)
+        k += sample64(seed, i) % size;
+    if (bits == 32)
+        return ((const uint32_t *)keys)[k];
+    return ((const uint64_t *)keys)[k];
+}
+
+/* Set by load_function() when batch pointers are a shared object's
+ * hash_batch(in, out, n) rather than hashing hf_lanes values in place.
+ */
+static int lib_batch;
+
+/* Hash n values in place, hf_lanes at a time through the batched
+ * function if there is one. A library's hash_batch() takes precedence,
+ * since it's not a program even when interpreting. Otherwise, when
+ * interpreting, batch is the program.
+ */
+static void
+hash32_n(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+         uint32_t *v, int n)
+{
+    int i = 0;
+    if (lib_batch && batch) {
+        void ABI (*hash_batch)(const uint32_t *, uint32_t *, size_t) =
+            (void *)batch;
+        hash_batch(v, v, n);
+        return;
+    }
+    if (hf_interpret && batch) {
+        hf_run32((void *)batch, v, n);
+        return;
+    }
+    if (batch)
+        for (; i + hf_lanes <= n; i += hf_lanes)
+            batch(v + i);
+    for (; i < n; i++)
+        v[i] = f(v[i]);
+}
+
+static void
+hash64_n(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+         uint64_t *v, int n)
+{
+    int i = 0;
+    if (lib_batch && batch) {
+        void ABI (*hash_batch)(const uint64_t *, uint64_t *, size_t) =
+            (void *)batch;
+        hash_batch(v, v, n);
+        return;
+    }
+    if (hf_interpret && batch) {
+        hf_run64((void *)batch, v, n);
+        return;
+    }
+    if (batch)
+        for (; i + hf_lanes <= n; i += hf_lanes)
+            batch(v + i);
+    for (; i < n; i++)
+        v[i] = f(v[i]);
+}
+
+static void *
+xcalloc(size_t n, size_t size)
+{
+    void *p = calloc(n, size);
+    if (!p) {
+        fprintf(stderr, "prospector: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/* Statistics gathered in the same pass as the avalanche bins, when
+ * enabled (-M). For each flipped input bit j, pairs[j][k][l] (k <= l)
+ * counts samples where output bits k and l both flip, with the flips
+ * of bit k alone on the diagonal, measuring bit independence.
+ * agree[i][k] counts samples where input bit i equals output bit k.
+ *
+ * Samples are buffered in blocks of 64 and transposed so that each
+ * count takes one popcount per block rather than one add per sample.
+ */
+struct bitstats {
+    int bits;
+    int fill;
+    long long n;
+    long long pairs[64][64][64];
+    long long agree[64][64];
+    uint64_t x[64];
+    uint64_t h0[64];
+    uint64_t set[64][64];  // [input bit][sample]
+};
+
+/* When non-null, estimates and exact measurements also accumulate
+ * these statistics, over all inputs they measure.
+ */
+static struct bitstats *bitstats;
+
+/* Transpose n words into bits words of n bits. */
+static void
+bitstats_transpose(const uint64_t *rows, int n, int bits, uint64_t *cols)
+{
+    for (int k = 0; k < bits; k++) {
+        uint64_t c = 0;
+        for (int s = 0; s < n; s++)
+            c |= (rows[s] >> k & 1) << s;
+        cols[k] = c;
+    }
+}
+
+static void
+bitstats_flush(struct bitstats *m)
+{
+    int bits = m->bits;
+    uint64_t mask = m->fill < 64 ? (UINT64_C(1) << m->fill) - 1
+                                 : ~UINT64_C(0);
+    uint64_t a[64], b[64];
+
+    bitstats_transpose(m->x, m->fill, bits, a);
+    bitstats_transpose(m->h0, m->fill, bits, b);
+    for (int i = 0; i < bits; i++)
+        for (int k = 0; k < bits; k++)
+            m->agree[i][k] += __builtin_popcountll(~(a[i] ^ b[k]) & mask);
+
+    for (int j = 0; j < bits; j++) {
+        bitstats_transpose(m->set[j], m->fill, bits, a);
+        for (int k = 0; k < bits; k++)
+            for (int l = k; l < bits; l++)
+                m->pairs[j][k][l] += __builtin_popcountll(a[k] & a[l]);
+    }
+
+    m->n += m->fill;
+    m->fill = 0;
+}
+
+/* A thread's private statistics, or null if they're disabled. */
+static struct bitstats *
+bitstats_local(void)
+{
+    if (!bitstats)
+        return 0;
+    struct bitstats *m = xcalloc(1, sizeof(*m));
+    m->bits = bitstats->bits;
+    return m;
+}
+
+static void
+bitstats_add32(struct bitstats *m, uint32_t x, uint32_t h0,
+               const uint32_t *h1)
+{
+    m->x[m->fill] = x;
+    m->h0[m->fill] = h0;
+    for (int j = 0; j < 32; j++)
+        m->set[j][m->fill] = h0 ^ h1[j];
+    if (++m->fill == 64)
+        bitstats_flush(m);
+}
+
+static void
+bitstats_add64(struct bitstats *m, uint64_t x, uint64_t h0,
+               const uint64_t *h1)
+{
+    m->x[m->fill] = x;
+    m->h0[m->fill] = h0;
+    for (int j = 0; j < 64; j++)
+        m->set[j][m->fill] = h0 ^ h1[j];
+    if (++m->fill == 64)
+        bitstats_flush(m);
+}
+
+/* Add a thread's statistics into the shared ones, and free them. */
+static void
+bitstats_merge(struct bitstats *m)
+{
+    int bits = m->bits;
+    bitstats_flush(m);
+    #pragma omp critical(bitstats)
+    {
+        bitstats->n += m->n;
+        for (int j = 0; j < bits; j++)
+            for (int k = 0; k < bits; k++)
+                for (int l = k; l < bits; l++)
+                    bitstats->pairs[j][k][l] += m->pairs[j][k][l];
+        for (int i = 0; i < bits; i++)
+            for (int k = 0; k < bits; k++)
+                bitstats->agree[i][k] += m->agree[i][k];
+    }
+    free(m);
+}
+
+/* Print the statistics as correlation coefficients, each summarized
+ * by its RMS (x1000, like bias) and its largest magnitude. An ideal
+ * function's coefficients are noise of about 1/sqrt(n).
+ */
+static void
+bitstats_print(const struct bitstats *m)
+{
+    int bits = m->bits;
+    double n = m->n;
+    double sum = 0, worst = 0;
+    int wj = 0, wk = 0, wl = 0;
+    long count = 0;
+    for (int j = 0; j < bits; j++) {
+        for (int k = 0; k < bits; k++) {
+            for (int l = k + 1; l < bits; l++) {
+                double pk = m->pairs[j][k][k] / n;
+                double pl = m->pairs[j][l][l] / n;
+                double pkl = m->pairs[j][k][l] / n;
+                double d = sqrt(pk * (1 - pk) * pl * (1 - pl));
+                double r = d > 0 ? (pkl - pk * pl) / d : 1;
+                sum += r * r;
+                count++;
+                if (fabs(r) > worst) {
+                    worst = fabs(r);
+                    wj = j;
+                    wk = k;
+                    wl = l;
+                }
+            }
+        }
+    }
+    printf("bic       = %.17g\n", sqrt(sum / count) * 1000.0);
+    printf("bic max   = %.6f (input bit %d, output bits %d and %d)\n",
+           worst, wj, wk, wl);
+
+    sum = worst = 0;
+    for (int i = 0; i < bits; i++) {
+        for (int k = 0; k < bits; k++) {
+            double r = 2.0 * m->agree[i][k] / n - 1;
+            sum += r * r;
+            if (fabs(r) > worst) {
+                worst = fabs(r);
+                wj = i;
+                wk = k;
+            }
+        }
+    }
+    printf("corr      = %.17g\n", sqrt(sum / (bits * bits)) * 1000.0);
+    printf("corr max  = %.6f (input bit %d, output bit %d)\n",
+           worst, wj, wk);
+}
+
+/* Input differences measured in place of single-bit flips (-d), each
+ * a mask XORed into 32-bit inputs. Avalanche bins then have a row per
+ * difference rather than per input bit. Zero means the usual single-bit
+ * flips.
+ */
+#define DIFF_MAX 1024
+static int diff_count;
+static uint32_t diff_masks[DIFF_MAX];
+
+/* Rows of the avalanche bins for functions of the given width. */
+static int
+bins_rows(int bits)
+{
+    return bits == 32 && diff_count ? diff_count : bits;
+}
+
+static uint32_t
+diff_mask(int j)
+{
+    return diff_count ? diff_masks[j] : UINT32_C(1) << j;
+}
+
+static void
+diff_add(uint32_t mask)
+{
+    if (diff_count == DIFF_MAX) {
+        fprintf(stderr, "prospector: too many differences, max %d\n",
+                DIFF_MAX);
+        exit(EXIT_FAILURE);
+    }
+    diff_masks[diff_count++] = mask;
+}
+
+/* Parse a comma-separated difference set: "pairs" for all 2-bit flips,
+ * "window:k" for each run of k adjacent bits, or a hexadecimal mask.
+ * Returns zero if the set is invalid.
+ */
+static int
+parse_diffs(const char *spec)
+{
+    for (const char *p = spec; *p; p += *p == ',') {
+        int k;
+        char *end;
+        char tok[32];
+        size_t len = strcspn(p, ",");
+        if (len >= sizeof(tok))
+            return 0;
+        memcpy(tok, p, len);
+        tok[len] = 0;
+        p += len;
+        if (!strcmp(tok, "pairs")) {
+            for (int i = 0; i < 32; i++)
+                for (int j = i + 1; j < 32; j++)
+                    diff_add(UINT32_C(1) << i | UINT32_C(1) << j);
+        } else if (sscanf(tok, "window:%d", &k) == 1) {
+            if (k < 1 || k > 32)
+                return 0;
+            uint32_t run = 0xffffffff >> (32 - k);
+            for (int i = 0; i <= 32 - k; i++)
+                diff_add(run << i);
+        } else {
+            unsigned long long mask = strtoull(tok, &end, 16);
+            if (*end || !mask || mask > 0xffffffff)
+                return 0;
+            diff_add(mask);
+        }
+    }
+    return diff_count;
+}
+
+/* Accumulate the avalanche bins for samples [beg, end) of total.
+ * Each input is hashed once and reused for every difference.
+ */
+static void
+estimate_range32(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+                 uint64_t seed, long total, long beg, long end, long *bins,
+                 struct bitstats *m)
+{
+    uint32_t xs[SAMPLE_BLOCK];
+    uint32_t hs[SAMPLE_BLOCK];
+    uint32_t h1[DIFF_MAX];
+    uint32_t masks[DIFF_MAX];
+    int rows = bins_rows(32);
+    for (int j = 0; j < rows; j++)
+        masks[j] = diff_mask(j);
+    for (long i = beg; i < end; i += SAMPLE_BLOCK) {
+        int n = end - i < SAMPLE_BLOCK ? end - i : SAMPLE_BLOCK;
+        for (int s = 0; s < n; s++)
+            hs[s] = xs[s] = sample_input(seed, i + s, total, 32);
+        hash32_n(f, batch, hs, n);
+        for (int s = 0; s < n; s++) {
+            for (int j = 0; j < rows; j++)
+                h1[j] = xs[s] ^ masks[j];
+            hash32_n(f, batch, h1, rows);
+            for (int j = 0; j < rows; j++) {
+                uint32_t set = hs[s] ^ h1[j];
+                for (int k = 0; k < 32; k++)
+                    bins[j * 32 + k] += (set >> k) & 1;
+            }
+            if (m)
+                bitstats_add32(m, xs[s], hs[s], h1);
+        }
+    }
+}
+
+static void
+estimate_range64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+                 uint64_t seed, long total, long beg, long end,
+                 long bins[64][64], struct bitstats *m)
+{
+    uint64_t xs[SAMPLE_BLOCK];
+    uint64_t hs[SAMPLE_BLOCK];
+    for (long i = beg; i < end; i += SAMPLE_BLOCK) {
+        int n = end - i < SAMPLE_BLOCK ? end - i : SAMPLE_BLOCK;
+        for (int s = 0; s < n; s++)
+            hs[s] = xs[s] = sample_input(seed, i + s, total, 64);
+        hash64_n(f, batch, hs, n);
+        for (int s = 0; s < n; s++) {
+            uint64_t h1[64];
+            for (int j = 0; j < 64; j++)
+                h1[j] = xs[s] ^ UINT64_C(1) << j;
+            hash64_n(f, batch, h1, 64);
+            for (int j = 0; j < 64; j++) {
+                uint64_t set = hs[s] ^ h1[j];
+                for (int k = 0; k < 64; k++)
+                    bins[j][k] += (set >> k) & 1;
+            }
+            if (m)
+                bitstats_add64(m, xs[s], hs[s], h1);
+        }
+    }
+}
+
+#define TRACE_EVENTS 65536  // most recent spans kept per thread, power of two
+
+struct trace_span {
+    const char *name;
+    uint64_t beg;
+    uint64_t end;
+};
+
+/* A thread's spans. Only its own thread writes to a ring, and rings are
+ * only read after all threads have joined, so no locks are needed.
+ */
+struct trace_ring {
+    char name[24];
+    unsigned long long head;
+    struct trace_span *spans;
+    char pad[64 - 24 - sizeof(unsigned long long) - sizeof(void *)];
+};
+
+/* Tracing is enabled when trace_path is non-null (-T). */
+static const char *trace_path;
+static int trace_nrings;
+static struct trace_ring *trace_rings;
+static uint64_t trace_epoch;
+
+static void
+trace_init(const char *path, int nthreads)
+{
+    trace_path = path;
+    trace_nrings = nthreads;
+    trace_rings = xcalloc(nthreads, sizeof(*trace_rings));
+    for (int i = 0; i < nthreads; i++)
+        trace_rings[i].spans = xcalloc(TRACE_EVENTS, sizeof(struct trace_span));
+    trace_epoch = nsclock();
+}
+
+/* Name the thread in the trace, e.g. "verifier 2". */
+static void
+trace_name(int tid, const char *role)
+{
+    if (trace_path)
+        snprintf(trace_rings[tid].name, sizeof(trace_rings[tid].name),
+                 "%s %d", role, tid);
+}
+
+/* Record a span on a thread's ring, overwriting its oldest span once
+ * the ring is full. Timestamps are from nsclock(). Tracing requires
+ * threads from a single team: nested teams would share rings.
+ */
+static void
+trace(int tid, const char *name, uint64_t beg, uint64_t end)
+{
+    if (!trace_path)
+        return;
+    struct trace_ring *r = trace_rings + tid;
+    struct trace_span *e = r->spans + (r->head++ & (TRACE_EVENTS - 1));
+    e->name = name;
+    e->beg = beg;
+    e->end = end;
+}
+
+/* Write all rings as a Chrome trace (JSON), viewable in Perfetto or
+ * chrome://tracing.
+ */
+static void
+trace_dump(void)
+{
+    if (!trace_path)
+        return;
+    FILE *f = fopen(trace_path, "w");
+    if (!f) {
+        fprintf(stderr, "prospector: %s: %s\n", trace_path, strerror(errno));
+        return;
+    }
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+    for (int t = 0; t < trace_nrings; t++) {
+        struct trace_ring *r = trace_rings + t;
+        fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", t,
+                r->name[0] ? r->name : "thread");
+        unsigned long long beg = r->head > TRACE_EVENTS ?
+                                 r->head - TRACE_EVENTS : 0;
+        for (unsigned long long i = beg; i < r->head; i++) {
+            struct trace_span *e = r->spans + (i & (TRACE_EVENTS - 1));
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e->name, t, (e->beg - trace_epoch) / 1e3,
+                    (e->end - e->beg) / 1e3);
+        }
+        fputs(t + 1 < trace_nrings ? ",\n" : "\n", f);
+    }
+    fputs("]}\n", f);
+    if (fclose(f))
+        fprintf(stderr, "prospector: %s: %s\n", trace_path, strerror(errno));
+}
+
+/* Convert size avalanche bins over n samples into a bias score.
+ */
+static double
+bins_bias(const long *bins, int size, long n)
+{
+    double mean = 0;
+    for (int i = 0; i < size; i++) {
+        /* FIXME: normalize this somehow */
+        double diff = (bins[i] - n / 2) / (n / 2.0);
+        mean += (diff * diff) / size;
+    }
+    return sqrt(mean) * 1000.0;
+}
+
+#define ESTIMATE_CHUNKS 64  // independent sample ranges per estimate
+
+/* Reduce per-chunk bins into a bias score. If se is non-null, also
+ * compute a delete-one-chunk jackknife standard error of the score.
+ */
+static double
+estimate_reduce(const long *chunks, int size, long n, double *se)
+{
+    long *total = xcalloc(size, sizeof(*total));
+    for (int c = 0; c < ESTIMATE_CHUNKS; c++)
+        for (int i = 0; i < size; i++)
+            total[i] += chunks[c * size + i];
+    double bias = bins_bias(total, size, n);
+
+    if (se) {
+        double theta[ESTIMATE_CHUNKS];
+        double mean = 0;
+        long *rest = xcalloc(size, sizeof(*rest));
+        for (int c = 0; c < ESTIMATE_CHUNKS; c++) {
+            long len = n * (c + 1) / ESTIMATE_CHUNKS -
+                       n * c / ESTIMATE_CHUNKS;
+            for (int i = 0; i < size; i++)
+                rest[i] = total[i] - chunks[c * size + i];
+            theta[c] = bins_bias(rest, size, n - len);
+            mean += theta[c] / ESTIMATE_CHUNKS;
+        }
+        double var = 0;
+        for (int c = 0; c < ESTIMATE_CHUNKS; c++)
+            var += (theta[c] - mean) * (theta[c] - mean);
+        *se = sqrt(var * (ESTIMATE_CHUNKS - 1) / ESTIMATE_CHUNKS);
+        free(rest);
+    }
+
+    free(total);
+    return bias;
+}
+
+/* Measures how each input bit affects each output bit. This measures
+ * both bias and avalanche. Samples are split across all threads.
+ */
+static double
+estimate32(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+           uint64_t seed, long n, double *se)
+{
+    int size = bins_rows(32) * 32;
+    long *chunks = xcalloc(ESTIMATE_CHUNKS * size, sizeof(*chunks));
+    #pragma omp parallel
+    {
+        struct bitstats *m = bitstats_local();
+        #pragma omp for schedule(dynamic)
+        for (int c = 0; c < ESTIMATE_CHUNKS; c++) {
+            long beg = n * c / ESTIMATE_CHUNKS;
+            long end = n * (c + 1) / ESTIMATE_CHUNKS;
+            if (!exact_cancel)
+                estimate_range32(f, batch, seed, n, beg, end,
+                                 chunks + c * size, m);
+        }
+        if (m)
+            bitstats_merge(m);
+    }
+    double bias = estimate_reduce(chunks, size, n, se);
+    free(chunks);
+    return bias;
+}
+
+static double
+estimate64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+           uint64_t seed, long n, double *se)
+{
+    long (*chunks)[64][64] = xcalloc(ESTIMATE_CHUNKS, sizeof(*chunks));
+    #pragma omp parallel
+    {
+        struct bitstats *m = bitstats_local();
+        #pragma omp for schedule(dynamic)
+        for (int c = 0; c < ESTIMATE_CHUNKS; c++) {
+            long beg = n * c / ESTIMATE_CHUNKS;
+            long end = n * (c + 1) / ESTIMATE_CHUNKS;
+            if (!exact_cancel)
+                estimate_range64(f, batch, seed, n, beg, end, chunks[c], m);
+        }
+        if (m)
+            bitstats_merge(m);
+    }
+    double bias = estimate_reduce(chunks[0][0], 64 * 64, n, se);
+    free(chunks);
+    return bias;
+}
+
+static double
+estimate_bias32(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+                uint64_t rng[2], double *se)
+{
+    uint64_t seed = xoroshiro128plus(rng);
+    return estimate32(f, batch, seed, keys_samples(1L << score_quality), se);
+}
+
+static double
+estimate_bias64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+                uint64_t rng[2], double *se)
+{
+    uint64_t seed = xoroshiro128plus(rng);
+    return estimate64(f, batch, seed, keys_samples(1L << score_quality), se);
+}
+
+/* Convert size exhaustive avalanche bins over n inputs into a bias
+ * score.
+ */
+static double
+exact_reduce(const long long *bins, int size, long long n)
+{
+    double mean = 0.0;
+    for (int i = 0; i < size; i++) {
+        double diff = (bins[i] - n / 2) / (n / 2.0);
+        mean += (diff * diff) / size;
+    }
+    return sqrt(mean) * 1000.0;
+}
+
+#define EXACT_CHUNKS 4096  // scheduling units per 2^32 pass, power of two
+#define EXACT_RANGE  ((UINT64_C(1) << 32) / EXACT_CHUNKS)
+
+/* Set asynchronously to request a progress report from exact_run().
+ * Reports are also made every report_interval seconds when nonzero,
+ * which also sets the interval of search statistics.
+ */
+static volatile sig_atomic_t exact_report;
+static long report_interval;
+static int exact_verbose;  // only reported for -E, not during searches
+
+/* Chunks computed by exact_run() in this process, for measuring speed.
+ */
+static long long exact_computed;
+
+/* Chunks are visited in a scrambled order, so that the inputs covered
+ * at any moment are spread over the whole domain without a pattern,
+ * and a partial result is representative of the full measurement. The
+ * order is a small xorshift-multiply permutation of the chunk indices.
+ */
+static long
+exact_block(long c)
+{
+    unsigned long x = c;
+    x ^= x >> 6;
+    x = x * 0x5a5 & (EXACT_CHUNKS - 1);
+    x ^= x >> 5;
+    x = x * 0x3b7 & (EXACT_CHUNKS - 1);
+    x ^= x >> 7;
+    return x;
+}
+
+#define EXACT_GROUPS 64  // interleaved groups of chunks for error estimates
+#define BINS_MAX (DIFF_MAX * 32 > 64 * 64 ? DIFF_MAX * 32 : 64 * 64)
+
+/* Completed chunks are accumulated into EXACT_GROUPS groups by their
+ * position in the visiting order, so that every group is spread over
+ * the domain. Their differences measure the uncertainty of a partial
+ * result.
+ */
+struct exact_groups {
+    long long n[EXACT_GROUPS];
+    long long bins[EXACT_GROUPS][BINS_MAX];
+};
+
+/* Bias of a partial measurement of n of total inputs, where bins is the
+ * sum of the groups (and possibly inputs measured earlier), along with
+ * a delete-a-group jackknife estimate of its standard error, corrected
+ * for sampling without replacement. A complete result is exact and has
+ * zero error. Group i measured gn[i] inputs into the bins starting at
+ * gbins + i*stride.
+ */
+static double
+exact_partial(const long long *bins, long long n, long long total,
+              const long long *gn, const long long *gbins, int stride,
+              int size, double *se)
+{
+    long long *rest = xcalloc(size, sizeof(*rest));
+    double bias = exact_reduce(bins, size, n);
+    double reps[EXACT_GROUPS];
+    int nreps = 0;
+    for (int i = 0; n < total && i < EXACT_GROUPS; i++) {
+        if (!gn[i] || gn[i] == n)
+            continue;
+        for (int j = 0; j < size; j++)
+            rest[j] = bins[j] - gbins[(long)i * stride + j];
+        reps[nreps++] = exact_reduce(rest, size, n - gn[i]);
+    }
+    free(rest);
+
+    double mean = 0.0;
+    for (int i = 0; i < nreps; i++)
+        mean += reps[i] / nreps;
+    double var = 0.0;
+    for (int i = 0; i < nreps; i++)
+        var += (reps[i] - mean) * (reps[i] - mean);
+    double fpc = 1.0 - (double)n / total;
+    *se = nreps > 1 ? sqrt(var * (nreps - 1) / nreps * fpc) : 0.0;
+    return bias;
+}
+
+/* Each thread owns a contiguous range of chunks and takes them in order
+ * from its own counter. Once its range runs dry, it steals from other
+ * threads' counters. Slots are padded to avoid false sharing.
+ */
+struct exact_slot {
+    long long next;
+    long long end;
+    char pad[64 - 2 * sizeof(long long)];
+};
+
+/* Accumulates avalanche bins for the inputs [beg, end) of a chunk,
+ * and the calling thread's statistics into m, if not null.
+ */
+typedef void (*exact_kernel)(const void *ctx, uint64_t beg, uint64_t end,
+                             long long *bins, struct bitstats *m);
+
+#define EXACT_PASSES     8   // most exact_run() calls per measurement
+#define CHECKPOINT_SECS 60   // interval between checkpoint writes
+
+/* Progress of an exhaustive measurement, saved so that it can resume
+ * after being killed. Each exact_run() call of the measurement is one
+ * pass: one for 32-bit functions, and one per 64-bit subdomain. The
+ * input differences (-d) are saved too, since they shape the bins.
+ */
+struct exact_ckpt {
+    const char *path;
+    char function[TEMPLATE_MAX + 16];
+    int bits;
+    int npass;
+    int size;
+    unsigned char done[EXACT_PASSES][EXACT_CHUNKS];
+    long long bins[EXACT_PASSES][BINS_MAX];
+};
+
+/* When non-null, exact_run() periodically saves its progress here.
+ */
+static struct exact_ckpt *exact_ckpt;
+
+/* Checkpoints are written to a temporary file, synced, then renamed
+ * over the old checkpoint so that a crash never leaves a torn file.
+ */
+static FILE *
+checkpoint_open(const char *path, char *tmp, size_t len)
+{
+    snprintf(tmp, len, "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f)
+        fprintf(stderr, "prospector: %s: %s\n", tmp, strerror(errno));
+    return f;
+}
+
+static void
+checkpoint_close(FILE *f, const char *path, const char *tmp)
+{
+    int err = fflush(f) || fsync(fileno(f));
+    err |= fclose(f);
+    if (err || rename(tmp, path))
+        fprintf(stderr, "prospector: %s: %s\n", path, strerror(errno));
+}
+
+static void
+exact_ckpt_write(const struct exact_ckpt *ck)
+{
+    char tmp[4096];
+    FILE *f = checkpoint_open(ck->path, tmp, sizeof(tmp));
+    if (!f)
+        return;
+    fprintf(f, "prospector-exact 3\n%s\n%d %d %d\n",
+            ck->function, ck->bits, ck->npass, diff_count);
+    for (int i = 0; i < diff_count; i++)
+        fprintf(f, "%08lx%c", (unsigned long)diff_masks[i],
+                i % 8 == 7 || i == diff_count - 1 ? '\n' : ' ');
+    for (int p = 0; p < ck->npass; p++) {
+        for (int c = 0; c < EXACT_CHUNKS; c++)
+            putc('0' + ck->done[p][c], f);
+        putc('\n', f);
+        for (int i = 0; i < ck->size; i++)
+            fprintf(f, "%lld%c", ck->bins[p][i], i % 16 == 15 ? '\n' : ' ');
+    }
+    checkpoint_close(f, ck->path, tmp);
+}
+
+/* Load a checkpoint, including the function it measures. Returns 0 if
+ * there's no checkpoint, or -1 if it's invalid for this measurement.
+ * Version 2 checkpoints predate -d and have no differences.
+ */
+static int
+exact_ckpt_load(struct exact_ckpt *ck)
+{
+    FILE *f = fopen(ck->path, "r");
+    if (!f)
+        return 0;
+
+    int version, bits, npass, ndiff = 0;
+    int ok = fscanf(f, "prospector-exact %d %1039[^\n] %d %d",
+                    &version, ck->function, &bits, &npass) == 4 &&
+             (version == 2 ||
+              (version == 3 && fscanf(f, "%d", &ndiff) == 1)) &&
+             bits == ck->bits && npass == ck->npass && ndiff == diff_count;
+    for (int i = 0; ok && i < ndiff; i++) {
+        unsigned long mask;
+        ok = fscanf(f, "%lx", &mask) == 1 && mask == diff_masks[i];
+    }
+    for (int p = 0; ok && p < npass; p++) {
+        static char done[EXACT_CHUNKS + 1];
+        ok = fscanf(f, " %4096[01]", done) == 1 &&
+             strlen(done) == EXACT_CHUNKS;
+        for (int c = 0; ok && c < EXACT_CHUNKS; c++)
+            ck->done[p][c] = done[c] - '0';
+        for (int i = 0; ok && i < ck->size; i++)
+            ok = fscanf(f, "%lld", &ck->bins[p][i]) == 1;
+    }
+    fclose(f);
+    return ok ? 1 : -1;
+}
+
+/* State shared by the threads of one exact_run(). Each group's bins
+ * and the done marks of its chunks are guarded by that group's lock.
+ */
+struct exact_team {
+    int size;
+    int bits;
+    int pass;
+    int npass;
+    long resumed;
+    uint64_t start;
+    struct exact_slot *slots;
+    omp_lock_t locks[EXACT_GROUPS];
+    struct exact_groups *groups;
+    long long *base;
+    unsigned char *done;
+};
+
+/* Capture a consistent view of the chunks completed so far: the total
+ * bins including resumed chunks, and the done marks.
+ */
+static void
+exact_snapshot(struct exact_team *t, long long *bins, unsigned char *done)
+{
+    for (int i = 0; i < EXACT_GROUPS; i++)
+        omp_set_lock(t->locks + i);
+    memcpy(bins, t->base, t->size * sizeof(*bins));
+    for (int i = 0; i < EXACT_GROUPS; i++)
+        for (int j = 0; j < t->size; j++)
+            bins[j] += t->groups->bins[i][j];
+    memcpy(done, t->done, EXACT_CHUNKS);
+    for (int i = 0; i < EXACT_GROUPS; i++)
+        omp_unset_lock(t->locks + i);
+}
+
+/* Report progress from a copy of each group, taken under only that
+ * group's lock so that the workers hardly notice.
+ */
+static void
+exact_progress(struct exact_team *t)
+{
+    int size = t->size;
+    long long *bins = xcalloc(size, sizeof(*bins));
+    long long *gbins = xcalloc((long)EXACT_GROUPS * size, sizeof(*gbins));
+    long long gn[EXACT_GROUPS];
+    long long n = t->resumed * (long long)EXACT_RANGE;
+    memcpy(bins, t->base, size * sizeof(*bins));
+    for (int i = 0; i < EXACT_GROUPS; i++) {
+        long long *g = gbins + (long)i * size;
+        omp_set_lock(t->locks + i);
+        gn[i] = t->groups->n[i];
+        memcpy(g, t->groups->bins[i], size * sizeof(*g));
+        omp_unset_lock(t->locks + i);
+        for (int j = 0; j < size; j++)
+            bins[j] += g[j];
+        n += gn[i];
+    }
+    long ndone = n / EXACT_RANGE;
+
+    double se;
+    double bias = exact_partial(bins, n, 1LL << 32, gn, gbins, size,
+                                size, &se);
+    free(gbins);
+    free(bins);
+    double secs = (uepoch() - t->start) / 1e6;
+    double rate = secs > 0 ? (ndone - t->resumed) / secs : 0;
+    long remain = EXACT_CHUNKS - ndone +
+                  (t->npass - t->pass - 1L) * EXACT_CHUNKS;
+    long eta = rate > 0 ? remain / rate : 0;
+    fprintf(stderr, "prospector: pass %d/%d, %ld/%d chunks, "
+            "%.3f Mhash/s, ETA %ld:%02ld:%02ld, bias %.6g +/- %.3g\n",
+            t->pass + 1, t->npass, ndone, EXACT_CHUNKS,
+            rate * EXACT_RANGE * (t->size / t->bits + 1) / 1e6,
+            eta / 3600, eta / 60 % 60, eta % 60, bias, se);
+}
+
+/* Exhaustively run a kernel over 2^32 inputs split into EXACT_CHUNKS
+ * work-stealing chunks, adding the results into bins (bins_rows() x
+ * bits). Threads are spread across the machine (see OMP_PLACES).
+ * Kernels accumulate each chunk into thread-local bins, which are merged into
+ * its group once per chunk. Returns the number of chunks completed,
+ * which is less than EXACT_CHUNKS if cancelled. If groups is not null,
+ * the groups completed by this run are added into it.
+ *
+ * If exact_ckpt is set, progress is saved to and resumed from the given
+ * pass of the checkpoint. Progress of the pass is reported to stderr on
+ * request (exact_report, report_interval).
+ */
+static long
+exact_run(exact_kernel kernel, const void *ctx, int bits, long long *bins,
+          struct exact_groups *groups, int pass, int npass)
+{
+    struct exact_ckpt *ck = exact_ckpt;
+    struct exact_team t = {
+        .size = bins_rows(bits) * bits,
+        .bits = bits,
+        .pass = pass,
+        .npass = npass,
+        .start = uepoch(),
+    };
+    t.base = xcalloc(t.size, sizeof(*t.base));
+    t.done = xcalloc(EXACT_CHUNKS, 1);
+    t.groups = xcalloc(1, sizeof(*t.groups));
+    for (int i = 0; i < EXACT_GROUPS; i++)
+        omp_init_lock(t.locks + i);
+    memcpy(t.base, bins, t.size * sizeof(*bins));
+    if (ck) {
+        memcpy(t.done, ck->done[pass], EXACT_CHUNKS);
+        for (int i = 0; i < t.size; i++)
+            t.base[i] += ck->bins[pass][i];
+        for (int c = 0; c < EXACT_CHUNKS; c++)
+            t.resumed += t.done[c];
+    }
+
+#if _OPENMP >= 201307
+    #pragma omp parallel proc_bind(spread)
+#else
+    #pragma omp parallel
+#endif
+    {
+        int id = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        #pragma omp single
+        {
+            t.slots = xcalloc(nthreads, sizeof(*t.slots));
+            for (int i = 0; i < nthreads; i++) {
+                t.slots[i].next = (long long)EXACT_CHUNKS * i / nthreads;
+                t.slots[i].end = (long long)EXACT_CHUNKS * (i + 1) / nthreads;
+            }
+        }
+        long long *part = xcalloc(t.size, sizeof(*part));
+        struct bitstats *m = bitstats_local();
+        if (exact_verbose)
+            trace_name(id, "exact");
+
+        uint64_t next = uepoch() + CHECKPOINT_SECS * 1000000LL;
+        uint64_t next_report = uepoch() + report_interval * 1000000LL;
+        for (int v = 0; v < nthreads && !exact_cancel; v++) {
+            struct exact_slot *slot = t.slots + (id + v) % nthreads;
+            while (!exact_cancel) {
+                long long c = __atomic_fetch_add(&slot->next, 1,
+                                                 __ATOMIC_RELAXED);
+                if (c >= slot->end)
+                    break;
+                long block = exact_block(c);
+                if (t.done[block])
+                    continue;  // resumed from checkpoint
+                uint64_t beg = block * EXACT_RANGE;
+                uint64_t end = beg + EXACT_RANGE;
+                uint64_t t0 = trace_path ? nsclock() : 0;
+                memset(part, 0, t.size * sizeof(*part));
+                kernel(ctx, beg, end, part, m);
+
+                int g = c % EXACT_GROUPS;
+                omp_set_lock(t.locks + g);
+                for (int i = 0; i < t.size; i++)
+                    t.groups->bins[g][i] += part[i];
+                t.groups->n[g] += EXACT_RANGE;
+                t.done[block] = 1;
+                omp_unset_lock(t.locks + g);
+                __atomic_fetch_add(&exact_computed, 1, __ATOMIC_RELAXED);
+                if (trace_path && exact_verbose)
+                    trace(id, "chunk", t0, nsclock());
+
+                if (id == 0 && exact_verbose &&
+                        (exact_report || (report_interval &&
+                                          uepoch() >= next_report))) {
+                    exact_report = 0;
+                    exact_progress(&t);
+                    next_report = uepoch() + report_interval * 1000000LL;
+                }
+                if (ck && id == 0 && uepoch() >= next) {
+                    uint64_t t1 = trace_path ? nsclock() : 0;
+                    exact_snapshot(&t, ck->bins[pass], ck->done[pass]);
+                    exact_ckpt_write(ck);
+                    if (trace_path && exact_verbose)
+                        trace(id, "checkpoint", t1, nsclock());
+                    next = uepoch() + CHECKPOINT_SECS * 1000000LL;
+                }
+            }
+        }
+        if (m)
+            bitstats_merge(m);
+        free(part);
+    }
+
+    long done = 0;
+    unsigned char marks[EXACT_CHUNKS];
+    exact_snapshot(&t, bins, marks);
+    for (int c = 0; c < EXACT_CHUNKS; c++)
+        done += marks[c];
+    for (int i = 0; groups && i < EXACT_GROUPS; i++) {
+        groups->n[i] += t.groups->n[i];
+        for (int j = 0; j < t.size; j++)
+            groups->bins[i][j] += t.groups->bins[i][j];
+    }
+    if (ck) {
+        memcpy(ck->bins[pass], bins, t.size * sizeof(*bins));
+        memcpy(ck->done[pass], marks, EXACT_CHUNKS);
+        exact_ckpt_write(ck);
+    }
+
+    for (int i = 0; i < EXACT_GROUPS; i++)
+        omp_destroy_lock(t.locks + i);
+    free(t.groups);
+    free(t.slots);
+    free(t.done);
+    free(t.base);
+    return done;
+}
+
+struct exact32 {
+    uint32_t ABI (*f)(uint32_t);
+    void ABI (*batch)(uint32_t *);
+};
+
+/* Like exact_kernel32(), but over the input differences (-d). Each
+ * input is hashed once and reused for every difference.
+ */
+static void
+exact_kernel_diff32(const struct exact32 *e, uint64_t beg, uint64_t end,
+                    long long *bins)
+{
+    uint32_t h[DIFF_MAX + 1];
+    for (uint64_t x = beg; x < end; x++) {
+        h[diff_count] = x;
+        for (int j = 0; j < diff_count; j++)
+            h[j] = x ^ diff_masks[j];
+        hash32_n(e->f, e->batch, h, diff_count + 1);
+        for (int j = 0; j < diff_count; j++) {
+            uint32_t set = h[diff_count] ^ h[j];
+            for (int k = 0; k < 32; k++)
+                bins[j * 32 + k] += (set >> k) & 1;
+        }
+    }
+}
+
+static void
+exact_kernel32(const void *ctx, uint64_t beg, uint64_t end, long long *bins,
+               struct bitstats *m)
+{
+    const struct exact32 *e = ctx;
+    if (diff_count) {
+        exact_kernel_diff32(e, beg, end, bins);
+        return;
+    }
+    long long b[32][32] = {{0}};
+    for (uint64_t x = beg; x < end; x++) {
+        uint32_t h[33];
+        h[32] = x;
+        for (int j = 0; j < 32; j++)
+            h[j] = x ^ UINT32_C(1) << j;
+        hash32_n(e->f, e->batch, h, 33);
+        for (int j = 0; j < 32; j++) {
+            uint32_t set = h[32] ^ h[j];
+            for (int k = 0; k < 32; k++)
+                b[j][k] += (set >> k) & 1;
+        }
+        if (m)
+            bitstats_add32(m, x, h[32], h);
+    }
+    for (int i = 0; i < 32 * 32; i++)
+        bins[i] += b[i / 32][i % 32];
+}
+
+/* Exact bias of a 32-bit function. If the measurement is cancelled,
+ * the partial result is returned, and its standard error is stored in
+ * se (if not null), which is otherwise zero.
+ */
+static double
+exact_bias32(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+             double *se)
+{
+    double error;
+    int size = bins_rows(32) * 32;
+    long long *bins = xcalloc(size, sizeof(*bins));
+    struct exact32 ctx = {f, batch};
+    struct exact_groups *groups = xcalloc(1, sizeof(*groups));
+    long done = exact_run(exact_kernel32, &ctx, 32, bins, groups, 0, 1);
+    long long n = done * (long long)EXACT_RANGE;
+    double bias = exact_partial(bins, n, 1LL << 32, groups->n,
+                                groups->bins[0], BINS_MAX, size, &error);
+    free(groups);
+    free(bins);
+    if (se)
+        *se = error;
+    return bias;
+}
+
+/* Fixed 32-bit words defining the structured 64-bit subdomains. Each
+ * subdomain pins one half of the input to one of these words and
+ * exhaustively enumerates the other half: the high half in the first
+ * set, and the low half in the mirrored set.
+ */
+static const uint32_t exact64_words[] = {
+    0x00000000, 0xffffffff, 0x9e3779b9, 0x7f4a7c15,
+};
+#define EXACT64_SUBDOMAINS (2 * countof(exact64_words))
+
+struct exact64 {
+    uint64_t ABI (*f)(uint64_t);
+    void ABI (*batch)(uint64_t *);
+    uint64_t word;
+    int mirror;
+};
+
+static void
+exact_kernel64(const void *ctx, uint64_t beg, uint64_t end, long long *bins,
+               struct bitstats *m)
+{
+    const struct exact64 *e = ctx;
+    long long b[64][64] = {{0}};
+    for (uint64_t y = beg; y < end; y++) {
+        uint64_t x = e->mirror ? y << 32 | e->word : e->word << 32 | y;
+        uint64_t h[65];
+        h[64] = x;
+        for (int j = 0; j < 64; j++)
+            h[j] = x ^ UINT64_C(1) << j;
+        hash64_n(e->f, e->batch, h, 65);
+        for (int j = 0; j < 64; j++) {
+            uint64_t set = h[64] ^ h[j];
+            for (int k = 0; k < 64; k++)
+                b[j][k] += (set >> k) & 1;
+        }
+        if (m)
+            bitstats_add64(m, x, h[64], h);
+    }
+    for (int i = 0; i < 64 * 64; i++)
+        bins[i] += b[i / 64][i % 64];
+}
+
+static long
+exact_bins64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+             int subdomain, long long bins[64][64],
+             struct exact_groups *groups)
+{
+    struct exact64 ctx = {
+        .f = f,
+        .batch = batch,
+        .word = exact64_words[subdomain % countof(exact64_words)],
+        .mirror = subdomain >= countof(exact64_words),
+    };
+    return exact_run(exact_kernel64, &ctx, 64, bins[0], groups, subdomain,
+                     EXACT64_SUBDOMAINS);
+}
+
+/* Exact bias of a 64-bit function over the structured subdomains. The
+ * bias of each subdomain is stored in sub, and the aggregate bias over
+ * all subdomains is returned. Like exact_bias32(), a cancelled
+ * measurement returns a partial result with its standard error in se,
+ * and the unmeasured subdomains are set to NaN.
+ */
+static double
+exact_bias64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+             double sub[EXACT64_SUBDOMAINS], double *se)
+{
+    double error;
+    long long n = 0;
+    static long long total[64][64];
+    static long long bins[64][64];
+    static struct exact_groups groups;
+    memset(total, 0, sizeof(total));
+    memset(&groups, 0, sizeof(groups));
+    for (int s = 0; s < EXACT64_SUBDOMAINS; s++) {
+        if (exact_cancel) {
+            sub[s] = NAN;
+            continue;
+        }
+        memset(bins, 0, sizeof(bins));
+        long long m = exact_bins64(f, batch, s, bins, &groups) * EXACT_RANGE;
+        sub[s] = exact_reduce(bins[0], 64 * 64, m);
+        for (int j = 0; j < 64; j++)
+            for (int k = 0; k < 64; k++)
+                total[j][k] += bins[j][k];
+        n += m;
+    }
+    long long all = (long long)EXACT64_SUBDOMAINS << 32;
+    double bias = exact_partial(total[0], n, all, groups.n, groups.bins[0],
+                                BINS_MAX, 64 * 64, &error);
+    if (se)
+        *se = error;
+    return bias;
+}
+
+/* Hash table workload (-W): a key set inserted into a table of 2^bits
+ * slots at a load factor, indexed by both the low bits of the hash (a
+ * mask) and the high bits (a shift, as in multiplicative hashing).
+ */
+struct table {
+    int bits;
+    double load;
+    enum {TABLE_SEQ, TABLE_STRIDE, TABLE_CLUSTER, TABLE_FILE} keys;
+    uint64_t stride;
+};
+
+/* When non-null, functions are scored by simulating this workload
+ * rather than by their bias.
+ */
+static struct table *table;
+
+#define TABLE_RUN 64  // consecutive keys per cluster (TABLE_CLUSTER)
+
+/* Parse a workload, "keys:bits:load", where keys is seq, stride=k (in
+ * hex, nonzero), cluster, or file (keys from -K). Returns zero if
+ * invalid.
+ */
+static int
+table_parse(struct table *t, const char *spec)
+{
+    int len = 0;
+    unsigned long long stride;
+    if (!strncmp(spec, "seq:", 4)) {
+        t->keys = TABLE_SEQ;
+        len = 4;
+    } else if (!strncmp(spec, "cluster:", 8)) {
+        t->keys = TABLE_CLUSTER;
+        len = 8;
+    } else if (!strncmp(spec, "file:", 5)) {
+        t->keys = TABLE_FILE;
+        len = 5;
+    } else if (sscanf(spec, "stride=%llx:%n", &stride, &len) == 1 && len &&
+               stride) {
+        t->keys = TABLE_STRIDE;
+        t->stride = stride;
+    } else {
+        return 0;
+    }
+    int end = 0;
+    sscanf(spec + len, "%d:%lf%n", &t->bits, &t->load, &end);
+    return end && !spec[len + end] && t->bits >= 4 && t->bits <= 28 &&
+           t->load > 0 && t->load < 1;
+}
+
+/* Number of keys inserted into the table. */
+static long
+table_keys(const struct table *t)
+{
+    long n = ldexp(t->load, t->bits);
+    return t->keys == TABLE_FILE ? keys_samples(n) : n;
+}
+
+static uint64_t
+table_key(const struct table *t, long i, long n, int bits)
+{
+    switch (t->keys) {
+        case TABLE_SEQ:
+            return i;
+        case TABLE_STRIDE:
+            return i * t->stride;
+        case TABLE_CLUSTER:
+            return sample64(0, i / TABLE_RUN) + i % TABLE_RUN;
+        case TABLE_FILE:
+            return sample_input(0, i, n, bits);
+    }
+    abort();
+}
+
+/* Results of a workload for one way of indexing. */
+struct table_stats {
+    double probe_mean;  // successful lookup
+    long probe_max;     // unsuccessful lookup
+    double chi2;        // per degree of freedom, about 1 when random
+    long bucket_max;
+};
+
+/* Measure a table with the given slot counts. Linear probing places
+ * keys in any insertion order at the same total displacement, so it's
+ * computed from the counts: the keys carried out of each slot are each
+ * displaced one further. The first pass settles the keys, and the
+ * clusters, carried around the end into slot 0, and the second measures
+ * the table. The longest cluster is the longest unsuccessful lookup.
+ */
+static void
+table_measure(const uint32_t *count, long m, long n, struct table_stats *r)
+{
+    double e = (double)n / m;
+    double chi2 = 0;
+    long carry = 0, run = 0, longest = 0, bucket_max = 0;
+    long long displaced = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (long i = 0; i < m; i++) {
+            long here = carry + count[i];
+            carry = here ? here - 1 : 0;
+            run = here ? run + 1 : 0;
+            if (pass) {
+                displaced += carry;
+                longest = run > longest ? run : longest;
+                chi2 += (count[i] - e) * (count[i] - e) / e;
+                bucket_max = count[i] > bucket_max ? count[i] : bucket_max;
+            }
+        }
+    }
+    r->probe_mean = 1 + (double)displaced / n;
+    r->probe_max = longest + 1;
+    r->chi2 = chi2 / (m - 1);
+    r->bucket_max = bucket_max;
+}
+
+/* Score n hashes of the given width under the workload: the mean,
+ * over both ways of indexing, of the ratios of the mean probe length to
+ * that of random hashing and of the chi-square statistic to its
+ * expectation, times 1000. Random hashing scores about 1000, and
+ * functions that spread the keys more evenly than random score lower.
+ * With verbose, the full results are printed.
+ */
+static double
+table_score(const struct table *t, const uint64_t *h, long n, int width,
+            int verbose)
+{
+    long m = 1L << t->bits;
+    uint32_t *count = xcalloc(2 * m, sizeof(*count));
+    for (long i = 0; i < n; i++) {
+        count[h[i] & (m - 1)]++;
+        count[m + (h[i] >> (width - t->bits))]++;
+    }
+
+    double alpha = (double)n / m;
+    double ideal = (1 + 1 / (1 - alpha)) / 2;
+    double sum = 0;
+    for (int i = 0; i < 2; i++) {
+        struct table_stats r;
+        table_measure(count + i * m, m, n, &r);
+        sum += r.probe_mean / ideal + r.chi2;
+        if (verbose) {
+            const char *name = i ? "high" : "low ";
+            printf("%s probe = %.6f mean, %ld max (random %.6f)\n",
+                   name, r.probe_mean, r.probe_max, ideal);
+            printf("%s chi2  = %.6f (bucket max %ld)\n",
+                   name, r.chi2, r.bucket_max);
+        }
+    }
+    free(count);
+    return sum / 4 * 1000.0;
+}
+
+static double
+table_score32(uint32_t ABI (*f)(uint32_t), void ABI (*batch)(uint32_t *),
+              int verbose)
+{
+    long n = table_keys(table);
+    uint32_t *v = xcalloc(n, sizeof(*v));
+    uint64_t *h = xcalloc(n, sizeof(*h));
+    for (long i = 0; i < n; i++)
+        v[i] = table_key(table, i, n, 32);
+    hash32_n(f, batch, v, n);
+    for (long i = 0; i < n; i++)
+        h[i] = v[i];
+    double score = table_score(table, h, n, 32, verbose);
+    free(h);
+    free(v);
+    return score;
+}
+
+static double
+table_score64(uint64_t ABI (*f)(uint64_t), void ABI (*batch)(uint64_t *),
+              int verbose)
+{
+    long n = table_keys(table);
+    uint64_t *h = xcalloc(n, sizeof(*h));
+    for (long i = 0; i < n; i++)
+        h[i] = table_key(table, i, n, 64);
+    hash64_n(f, batch, h, n);
+    double score = table_score(table, h, n, 64, verbose);
+    free(h);
+    return score;
+}
+
+#define ELITE_MAX       64
+#define VERIFY64_QUALITY 26  // stand-in for an exact score, 64-bit or keys
+
+/* Search counters. Each thread only updates its own set, padded to
+ * whole cache lines, so counting never contends. The sets are summed
+ * when reported.
+ */
+enum search_stat {
+    STAT_GENERATED,
+    STAT_PRUNED,
+    STAT_COMPILED,
+    STAT_REJECTED,
+    STAT_SCORED,
+    STAT_VERIFIED,
+    STAT_HASHES,
+    STAT_GENERATE_NS,
+    STAT_COMPILE_NS,
+    STAT_MPROTECT_NS,
+    STAT_SCORE_NS,
+    STAT_VERIFY_NS,
+    STAT_COUNT
+};
+
+static const char stat_names[][12] = {
+    [STAT_GENERATED]   = "generated",
+    [STAT_PRUNED]      = "pruned",
+    [STAT_COMPILED]    = "compiled",
+    [STAT_REJECTED]    = "rejected",
+    [STAT_SCORED]      = "scored",
+    [STAT_VERIFIED]    = "verified",
+    [STAT_HASHES]      = "hashes",
+    [STAT_GENERATE_NS] = "generate",
+    [STAT_COMPILE_NS]  = "compile",
+    [STAT_MPROTECT_NS] = "mprotect",
+    [STAT_SCORE_NS]    = "score",
+    [STAT_VERIFY_NS]   = "verify",
+};
+
+/* Padded to whole cache lines, and allocated on one, so that threads
+ * never share a line.
+ */
+struct stats {
+    uint64_t v[16];
+};
+
+/* Only the owning thread writes, so no read-modify-write is needed, but
+ * the accesses are atomic so that reports never read torn values.
+ */
+static void
+stat_add(struct stats *st, enum search_stat i, uint64_t n)
+{
+    uint64_t v = __atomic_load_n(st->v + i, __ATOMIC_RELAXED);
+    __atomic_store_n(st->v + i, v + n, __ATOMIC_RELAXED);
+}
+
+struct elite {
+    struct hf_op ops[32];
+    int nops;
+    int busy;  // being verified
+    double estimate;
+    double exact;
+    double latency;  // from the cost model
+};
+
+/* Shared state of a parallel search. Candidates whose estimate clears
+ * the bar join the pending list, sorted by estimate. Verifiers take the
+ * best pending candidate, score it exactly, and rank it on the
+ * leaderboard by exact score. Candidates stay pending while being
+ * verified so that a checkpoint never loses them. Both lists are only
+ * accessed inside the "elite" critical section.
+ *
+ * In Pareto mode the leaderboard is instead the Pareto front of
+ * (latency, exact bias), sorted by latency, and candidates dominated by
+ * the front are not worth verifying.
+ */
+struct search {
+    int flags;
+    int min, max;
+    int nops;
+    const struct hf_op *template;  // null for unconstrained search
+    double threshold;
+    int pareto;
+    double budget;  // most latency (nsec) worth evaluating, 0 for any
+    int nelite;
+    int verifiers;
+    int npending;
+    int nboard;
+    struct elite pending[ELITE_MAX];
+    struct elite board[ELITE_MAX];
+    const char *checkpoint;
+    uint64_t next_checkpoint;
+    uint64_t rng[2];
+    uint64_t (*rngs)[2];  // each thread's generator as of its last offer
+    int nrngs;
+    uint64_t keyhash;  // keys_hash() of the -K keys
+    const char *metrics;  // Prometheus text file, or null
+    int nthreads;
+    struct stats *stats;  // one per thread
+    uint64_t start;
+    uint64_t next_report;
+};
+
+static int
+elite_known(const struct search *s, const struct hf_op *ops, int n)
+{
+    for (int i = 0; i < s->npending; i++)
+        if (hf_same(s->pending[i].ops, s->pending[i].nops, ops, n))
+            return 1;
+    for (int i = 0; i < s->nboard; i++)
+        if (hf_same(s->board[i].ops, s->board[i].nops, ops, n))
+            return 1;
+    return 0;
+}
+
+/* The estimate a candidate must beat to be worth verifying. In Pareto
+ * mode only the threshold applies, and the rest is up to dominance.
+ */
+static double
+elite_bar(const struct search *s)
+{
+    double bar = s->threshold;
+    if (s->pareto)
+        return bar;
+    if (s->nboard == s->nelite && s->board[s->nboard - 1].exact < bar)
+        bar = s->board[s->nboard - 1].exact;
+    if (s->npending == s->nelite && s->pending[s->npending - 1].estimate < bar)
+        bar = s->pending[s->npending - 1].estimate;
+    return bar;
+}
+
+/* Return 1 if a function is no faster and no less biased than a
+ * member of the Pareto front.
+ */
+static int
+elite_dominated(const struct search *s, double latency, double bias)
+{
+    for (int i = 0; i < s->nboard; i++)
+        if (s->board[i].latency <= latency && s->board[i].exact <= bias)
+            return 1;
+    return 0;
+}
+
+/* Remove pending candidate i, returning the slot freed at the end.
+ */
+static int
+elite_drop(struct search *s, int i)
+{
+    memmove(s->pending + i, s->pending + i + 1,
+            (s->npending - i - 1) * sizeof(*s->pending));
+    return s->npending - 1;
+}
+
+/* Find where a candidate goes on the pending list. A full list makes
+ * room by dropping its worst candidate with a worse estimate, not
+ * counting those being verified. Returns the free slot at the end of
+ * the list, or -1 to reject.
+ */
+static int
+elite_slot(struct search *s, double estimate)
+{
+    if (s->npending < s->nelite)
+        return s->npending++;
+    for (int i = s->npending - 1; i >= 0; i--) {
+        if (s->pending[i].estimate <= estimate)
+            break;
+        if (!s->pending[i].busy)
+            return elite_drop(s, i);
+    }
+    return -1;
+}
+
+/* Find where a Pareto mode candidate goes on the pending list. It's
+ * turned away if the front or a pending candidate dominates it. A full
+ * list makes room by dropping the least promising pending candidate it
+ * dominates, not counting those being verified. Returns the free slot
+ * at the end of the list, or -1 to reject.
+ */
+static int
+elite_admit(struct search *s, double latency, double estimate)
+{
+    if (elite_dominated(s, latency, estimate))
+        return -1;
+    int drop = -1;
+    for (int i = 0; i < s->npending; i++) {
+        const struct elite *p = s->pending + i;
+        if (p->latency <= latency && p->estimate <= estimate)
+            return -1;
+        if (!p->busy && latency <= p->latency && estimate <= p->estimate)
+            drop = i;  // sorted by estimate, so the last is the worst
+    }
+    if (s->npending < s->nelite)
+        return s->npending++;
+    return drop < 0 ? -1 : elite_drop(s, drop);
+}
+
+static int
+elite_offer(struct search *s, const struct hf_op *ops, int n, double score,
+            double latency)
+{
+    if (score >= elite_bar(s) || elite_known(s, ops, n))
+        return 0;
+    int i = s->pareto ? elite_admit(s, latency, score)
+                      : elite_slot(s, score);
+    if (i < 0)
+        return 0;
+    for (; i > 0 && s->pending[i - 1].estimate > score; i--)
+        s->pending[i] = s->pending[i - 1];
+    memcpy(s->pending[i].ops, ops, n * sizeof(*ops));
+    s->pending[i].nops = n;
+    s->pending[i].busy = 0;
+    s->pending[i].estimate = score;
+    s->pending[i].exact = -1;
+    s->pending[i].latency = latency;
+    return 1;
+}
+
+static int
+elite_take(struct search *s, struct elite *e)
+{
+    for (int i = 0; i < s->npending; i++) {
+        if (!s->pending[i].busy) {
+            s->pending[i].busy = 1;
+            *e = s->pending[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+elite_print(const struct search *s, int rank)
+{
+    const struct elite *e = s->board + rank;
+    if (s->pareto)
+        printf("// exact = %.17g, estimate = %.17g, latency = %.3f\n",
+               e->exact, e->estimate, e->latency);
+    else
+        printf("// exact = %.17g, estimate = %.17g, rank = %d\n",
+               e->exact, e->estimate, rank + 1);
+    hf_printfunc(e->ops, e->nops, stdout);
+    printf(s->pareto ? "// pareto front (nsec, bias)\n" : "// leaderboard\n");
+    for (int i = 0; i < s->nboard; i++) {
+        char buf[TEMPLATE_MAX];
+        hf_template(s->board[i].ops, s->board[i].nops, buf);
+        if (s->pareto)
+            printf("// %2d %.3f %.17g %s\n", i + 1, s->board[i].latency,
+                   s->board[i].exact, buf);
+        else
+            printf("// %2d %.17g %s\n", i + 1, s->board[i].exact, buf);
+    }
+    fflush(stdout);
+}
+
+/* Insert a verified candidate into the Pareto front, dropping members
+ * it dominates, and print the front if it joins.
+ */
+static void
+elite_front(struct search *s, const struct elite *e)
+{
+    if (elite_dominated(s, e->latency, e->exact))
+        return;
+    int n = 0;
+    for (int i = 0; i < s->nboard; i++)
+        if (s->board[i].latency < e->latency || s->board[i].exact < e->exact)
+            s->board[n++] = s->board[i];
+    s->nboard = n;
+    if (s->nboard == ELITE_MAX)
+        return;
+    int i = s->nboard++;
+    for (; i > 0 && s->board[i - 1].latency > e->latency; i--)
+        s->board[i] = s->board[i - 1];
+    s->board[i] = *e;
+    elite_print(s, i);
+}
+
+/* Insert a verified candidate into the leaderboard, printing the
+ * leaderboard if it ranks.
+ */
+static void
+elite_rank(struct search *s, const struct elite *e)
+{
+    for (int i = 0; i < s->npending; i++) {
+        if (hf_same(s->pending[i].ops, s->pending[i].nops, e->ops, e->nops)) {
+            s->npending--;
+            memmove(s->pending + i, s->pending + i + 1,
+                    (s->npending - i) * sizeof(*e));
+            break;
+        }
+    }
+
+    if (s->pareto) {
+        elite_front(s, e);
+        return;
+    }
+    if (s->nboard == s->nelite && e->exact >= s->board[s->nboard - 1].exact)
+        return;
+    int i = s->nboard < s->nelite ? s->nboard++ : s->nboard - 1;
+    for (; i > 0 && s->board[i - 1].exact > e->exact; i--)
+        s->board[i] = s->board[i - 1];
+    s->board[i] = *e;
+    elite_print(s, i);
+}
+
+/* Score a candidate as precisely as practical: exactly for 32-bit, and
+ * with a deterministic high-quality estimate for 64-bit or over keys.
+ * A table workload is deterministic, so it's simply scored again.
+ */
+static double
+elite_verify(const struct elite *e, int flags, void *buf)
+{
+    double score;
+    hf_compile(e->ops, e->nops, buf);
+    execbuf_lock(buf);
+    long n = keys_samples(1L << VERIFY64_QUALITY);
+    if (table && flags & F_U64) {
+        score = table_score64(buf, hf_batch(buf), 0);
+    } else if (table) {
+        score = table_score32(buf, hf_batch(buf), 0);
+    } else if (flags & F_U64) {
+        uint64_t ABI (*hash)(uint64_t) = buf;
+        score = estimate64(hash, hf_batch(buf), 0, n, 0);
+    } else if (nkeys) {
+        uint32_t ABI (*hash)(uint32_t) = buf;
+        score = estimate32(hash, hf_batch(buf), 0, n, 0);
+    } else {
+        uint32_t ABI (*hash)(uint32_t) = buf;
+        score = exact_bias32(hash, hf_batch(buf), 0);
+    }
+    execbuf_unlock(buf);
+    return score;
+}
+
+/* Verify the best pending candidate, if any. Return 0 if none.
+ */
+static int
+search_verify(struct search *s, struct stats *st, void *buf)
+{
+    int got;
+    struct elite e;
+    int id = st - s->stats;
+    uint64_t t0 = trace_path ? nsclock() : 0;
+    #pragma omp critical(elite)
+    got = elite_take(s, &e);
+    if (!got)
+        return 0;
+    uint64_t t1 = nsclock();
+    trace(id, "take", t0, t1);
+    e.exact = elite_verify(&e, s->flags, buf);
+    uint64_t t2 = nsclock();
+    trace(id, "verify", t1, t2);
+    if (exact_cancel)
+        return 0;  // interrupted, so it stays pending
+    stat_add(st, STAT_VERIFY_NS, t2 - t1);
+    stat_add(st, STAT_VERIFIED, 1);
+    uint64_t n = keys_samples(1L << VERIFY64_QUALITY);
+    if (table)
+        stat_add(st, STAT_HASHES, table_keys(table));
+    else if (s->flags & F_U64)
+        stat_add(st, STAT_HASHES, n * 65);
+    else if (nkeys)
+        stat_add(st, STAT_HASHES, n * (bins_rows(32) + 1));
+    else
+        stat_add(st, STAT_HASHES, (UINT64_C(1) << 32) * (bins_rows(32) + 1));
+    #pragma omp critical(elite)
+    elite_rank(s, &e);
+    if (trace_path)
+        trace(id, "rank", t2, nsclock());
+    return 1;
+}
+
+static void
+search_save(struct search *s)
+{
+    char tmp[4096];
+    FILE *f = checkpoint_open(s->checkpoint, tmp, sizeof(tmp));
+    if (!f)
+        return;
+    fprintf(f, "prospector-search 2\nflags %d\n", s->flags & F_U64);
+
+    /* The objective: table workload (-W), differences (-d), keys (-K) */
+    static const struct table none;
+    const struct table *t = table ? table : &none;
+    fprintf(f, "table %d %d %.17g %016llx\ndiff %d\n",
+            table ? (int)t->keys : -1, t->bits, t->load,
+            (unsigned long long)t->stride, diff_count);
+    for (int i = 0; i < diff_count; i++)
+        fprintf(f, "%08lx%c", (unsigned long)diff_masks[i],
+                i % 8 == 7 || i == diff_count - 1 ? '\n' : ' ');
+    fprintf(f, "keys %ld %016llx\n", nkeys, (unsigned long long)s->keyhash);
+
+    fprintf(f, "rng %016llx %016llx\n",
+            (unsigned long long)s->rng[0], (unsigned long long)s->rng[1]);
+    for (int i = 0; i < s->nrngs; i++)
+        fprintf(f, "thread %016llx %016llx\n",
+                (unsigned long long)s->rngs[i][0],
+                (unsigned long long)s->rngs[i][1]);
+    for (int i = 0; i < s->npending; i++) {
+        char buf[TEMPLATE_MAX];
+        hf_template(s->pending[i].ops, s->pending[i].nops, buf);
+        fprintf(f, "pending %.17g %s\n", s->pending[i].estimate, buf);
+    }
+    for (int i = 0; i < s->nboard; i++) {
+        char buf[TEMPLATE_MAX];
+        hf_template(s->board[i].ops, s->board[i].nops, buf);
+        fprintf(f, "board %.17g %.17g %s\n",
+                s->board[i].exact, s->board[i].estimate, buf);
+    }
+    checkpoint_close(f, s->checkpoint, tmp);
+}
+
+/* Restore the pending list, leaderboard and RNGs from a checkpoint.
+ * Returns 0 if there's no checkpoint, -1 if it's invalid, or -2 if its
+ * search scored candidates differently. Version 1 checkpoints predate
+ * -W, -d and -K, and only resume a search using none of them.
+ */
+static int
+search_load(struct search *s, uint64_t rng[2])
+{
+    FILE *f = fopen(s->checkpoint, "r");
+    if (!f)
+        return 0;
+
+    int version, flags;
+    unsigned long long r[2];
+    char line[TEMPLATE_MAX + 128];
+    int ok = fscanf(f, "prospector-search %d flags %d",
+                    &version, &flags) == 2 &&
+             flags == (s->flags & F_U64);
+    int same = !table && !diff_count && !nkeys;
+    if (ok && version == 2) {
+        int kind = 0, bits = 0, ndiff = 0;
+        double load = 0;
+        unsigned long long stride = 0, hash = 0;
+        long n = 0;
+        ok = fscanf(f, " table %d %d %lf %llx diff %d",
+                    &kind, &bits, &load, &stride, &ndiff) == 5 &&
+             ndiff >= 0 && ndiff <= DIFF_MAX;
+        same = table ? kind == (int)table->keys && bits == table->bits &&
+                       load == table->load && stride == table->stride
+                     : kind == -1;
+        same = same && ndiff == diff_count;
+        for (int i = 0; ok && i < ndiff; i++) {
+            unsigned long mask;
+            ok = fscanf(f, "%lx", &mask) == 1;
+            same = same && mask == diff_masks[i];
+        }
+        ok = ok && fscanf(f, " keys %ld %llx", &n, &hash) == 2;
+        same = same && n == nkeys && hash == s->keyhash;
+    } else {
+        ok = ok && version == 1;
+    }
+    ok = ok && fscanf(f, " rng %llx %llx ", r + 0, r + 1) == 2;
+    if (ok && !same) {
+        fclose(f);
+        return -2;
+    }
+    while (ok && fgets(line, sizeof(line), f)) {
+        struct elite e = {.exact = -1};
+        char buf[TEMPLATE_MAX];
+        unsigned long long t[2];
+        if (sscanf(line, "thread %llx %llx", t + 0, t + 1) == 2) {
+            s->rngs = realloc(s->rngs, (s->nrngs + 1) * sizeof(*s->rngs));
+            if (!s->rngs) {
+                fprintf(stderr, "prospector: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+            s->rngs[s->nrngs][0] = t[0];
+            s->rngs[s->nrngs][1] = t[1];
+            s->nrngs++;
+        } else if (sscanf(line, "pending %lf %1023s",
+                          &e.estimate, buf) == 2 &&
+                   s->npending < s->nelite) {
+            e.nops = parse_template(e.ops, countof(e.ops), buf, flags);
+            e.latency = hf_latency(e.ops, e.nops);
+            ok = e.nops > 0;
+            s->pending[s->npending++] = e;
+        } else if (sscanf(line, "board %lf %lf %1023s",
+                          &e.exact, &e.estimate, buf) == 3 &&
+                   s->nboard < (s->pareto ? ELITE_MAX : s->nelite)) {
+            e.nops = parse_template(e.ops, countof(e.ops), buf, flags);
+            e.latency = hf_latency(e.ops, e.nops);
+            ok = e.nops > 0;
+            s->board[s->nboard++] = e;
+        }
+    }
+    fclose(f);
+    rng[0] = r[0];
+    rng[1] = r[1];
+    return ok ? 1 : -1;
+}
+
+/* Report search statistics as a line on stderr (with -i) and as a
+ * Prometheus text file (with -m). The lists are only read inside the
+ * "elite" critical section, so the caller passes the number pending
+ * and the best verified bias (negative if none) as of its last look.
+ */
+static void
+search_report(struct search *s, int npending, double best)
+{
+    uint64_t v[STAT_COUNT] = {0};
+    for (int i = 0; i < s->nthreads; i++)
+        for (int j = 0; j < STAT_COUNT; j++)
+            v[j] += __atomic_load_n(s->stats[i].v + j, __ATOMIC_RELAXED);
+    double secs = (uepoch() - s->start) / 1e6;
+    double busy = secs * s->nthreads * 1e9;  // thread-nanoseconds
+
+    if (report_interval) {
+        fprintf(stderr, "prospector: %llu generated (%.1f/s), %llu pruned, "
+                "%llu rejected, %llu verified, %.3f Mhash/s, time:",
+                (unsigned long long)v[STAT_GENERATED],
+                v[STAT_GENERATED] / secs,
+                (unsigned long long)v[STAT_PRUNED],
+                (unsigned long long)v[STAT_REJECTED],
+                (unsigned long long)v[STAT_VERIFIED],
+                v[STAT_HASHES] / secs / 1e6);
+        for (int j = STAT_GENERATE_NS; j <= STAT_VERIFY_NS; j++)
+            fprintf(stderr, " %s %.1f%%", stat_names[j], v[j] * 100 / busy);
+        fputc('\n', stderr);
+    }
+
+    if (s->metrics) {
+        char tmp[4096];
+        FILE *f = checkpoint_open(s->metrics, tmp, sizeof(tmp));
+        if (!f)
+            return;
+        fprintf(f, "# HELP prospector_candidates_total "
+                "Candidate functions by pipeline stage.\n");
+        fprintf(f, "# TYPE prospector_candidates_total counter\n");
+        for (int j = STAT_GENERATED; j <= STAT_VERIFIED; j++)
+            fprintf(f, "prospector_candidates_total{stage=\"%s\"} %llu\n",
+                    stat_names[j], (unsigned long long)v[j]);
+        fprintf(f, "# HELP prospector_hashes_total "
+                "Hash function evaluations.\n");
+        fprintf(f, "# TYPE prospector_hashes_total counter\n");
+        fprintf(f, "prospector_hashes_total %llu\n",
+                (unsigned long long)v[STAT_HASHES]);
+        fprintf(f, "# HELP prospector_seconds_total "
+                "Thread time spent by pipeline stage.\n");
+        fprintf(f, "# TYPE prospector_seconds_total counter\n");
+        for (int j = STAT_GENERATE_NS; j <= STAT_VERIFY_NS; j++)
+            fprintf(f, "prospector_seconds_total{stage=\"%s\"} %.9f\n",
+                    stat_names[j], v[j] / 1e9);
+        fprintf(f, "# HELP prospector_uptime_seconds "
+                "Time since the search started.\n");
+        fprintf(f, "# TYPE prospector_uptime_seconds gauge\n");
+        fprintf(f, "prospector_uptime_seconds %.3f\n", secs);
+        fprintf(f, "# HELP prospector_threads Search threads.\n");
+        fprintf(f, "# TYPE prospector_threads gauge\n");
+        fprintf(f, "prospector_threads %d\n", s->nthreads);
+        fprintf(f, "# HELP prospector_pending Candidates awaiting "
+                "verification.\n");
+        fprintf(f, "# TYPE prospector_pending gauge\n");
+        fprintf(f, "prospector_pending %d\n", npending);
+        if (best >= 0) {
+            fprintf(f, "# HELP prospector_best_bias "
+                    "Best verified bias on the leaderboard.\n");
+            fprintf(f, "# TYPE prospector_best_bias gauge\n");
+            fprintf(f, "prospector_best_bias %.17g\n", best);
+        }
+        checkpoint_close(f, s->metrics, tmp);
+    }
+}
+
+static void
+search_generate(struct search *s, struct stats *st, uint64_t rng[2],
+                void *buf)
+{
+    int nops = s->nops;
+    struct hf_op ops[32];
+    int id = st - s->stats;
+    uint64_t t0 = nsclock();
+
+    /* Generate */
+    if (s->template) {
+        memcpy(ops, s->template, nops * sizeof(*ops));
+        hf_randfunc(ops, nops, rng);
+    } else {
+        nops = s->min + xoroshiro128plus(rng) % (s->max - s->min + 1);
+        hf_genfunc(ops, nops, s->flags, rng);
+    }
+    uint64_t t1 = nsclock();
+    stat_add(st, STAT_GENERATED, 1);
+    stat_add(st, STAT_GENERATE_NS, t1 - t0);
+    double latency = hf_latency(ops, nops);
+    if (s->budget && latency > s->budget) {
+        stat_add(st, STAT_PRUNED, 1);
+        return;
+    }
+
+    /* Evaluate */
+    double score;
+    hf_compile(ops, nops, buf);
+    uint64_t t2 = nsclock();
+    stat_add(st, STAT_COMPILED, 1);
+    stat_add(st, STAT_COMPILE_NS, t2 - t1);
+    execbuf_lock(buf);
+    uint64_t t3 = nsclock();
+    if (table) {
+        if (s->flags & F_U64)
+            score = table_score64(buf, hf_batch(buf), 0);
+        else
+            score = table_score32(buf, hf_batch(buf), 0);
+        stat_add(st, STAT_HASHES, table_keys(table));
+    } else if (s->flags & F_U64) {
+        uint64_t ABI (*hash)(uint64_t) = buf;
+        score = estimate_bias64(hash, hf_batch(buf), rng, 0);
+        stat_add(st, STAT_HASHES, keys_samples(1L << score_quality) * 65);
+    } else {
+        uint32_t ABI (*hash)(uint32_t) = buf;
+        score = estimate_bias32(hash, hf_batch(buf), rng, 0);
+        stat_add(st, STAT_HASHES,
+                 keys_samples(1L << score_quality) * (bins_rows(32) + 1));
+    }
+    uint64_t t4 = nsclock();
+    execbuf_unlock(buf);
+    uint64_t t5 = nsclock();
+    stat_add(st, STAT_SCORED, 1);
+    stat_add(st, STAT_SCORE_NS, t4 - t3);
+    stat_add(st, STAT_MPROTECT_NS, (t3 - t2) + (t5 - t4));
+    trace(id, "generate", t0, t1);
+    trace(id, "compile", t1, t2);
+    trace(id, "mprotect", t2, t3);
+    trace(id, "estimate", t3, t4);
+    trace(id, "mprotect", t4, t5);
+    if (exact_cancel)
+        return;  // interrupted, so the score is incomplete
+
+    /* Compare */
+    int report = 0;
+    int npending = 0;
+    double best = -1;
+    #pragma omp critical(elite)
+    {
+        if (!elite_offer(s, ops, nops, score, latency))
+            stat_add(st, STAT_REJECTED, 1);
+        s->rngs[id][0] = rng[0];
+        s->rngs[id][1] = rng[1];
+        if (s->checkpoint && uepoch() >= s->next_checkpoint) {
+            uint64_t t = trace_path ? nsclock() : 0;
+            search_save(s);
+            trace(id, "checkpoint", t, trace_path ? nsclock() : 0);
+            s->next_checkpoint = uepoch() + CHECKPOINT_SECS * 1000000LL;
+        }
+        if (s->next_report && uepoch() >= s->next_report) {
+            report = 1;
+            npending = s->npending;
+            best = s->nboard ? s->board[0].exact : -1;
+            long interval = report_interval ? report_interval : 10;
+            s->next_report = uepoch() + interval * 1000000LL;
+        }
+    }
+    if (report)
+        search_report(s, npending, best);
+    if (trace_path)
+        trace(id, "offer", t5, nsclock());
+}
+
+/* Set asynchronously to stop a search. */
+static volatile sig_atomic_t search_stop;
+
+static void
+search_sigint(int sig)
+{
+    /* A second interrupt kills the process */
+    signal(sig, SIG_DFL);
+    search_stop = 1;
+    exact_cancel = 1;
+}
+
+/* Run a search until interrupted. The first s->verifiers threads verify
+ * pending candidates while the rest generate them. Without dedicated
+ * verifiers, the lone generator verifies between candidates. On
+ * SIGINT, the threads finish their current step, then the checkpoint,
+ * metrics and trace are written out one last time. Threads continue
+ * the generators restored from a checkpoint, and any further threads
+ * are seeded from rng.
+ */
+static void
+search_run(struct search *s, uint64_t rng[2])
+{
+    uint64_t seed = xoroshiro128plus(rng);
+    s->rng[0] = rng[0];
+    s->rng[1] = rng[1];
+    s->next_checkpoint = uepoch() + CHECKPOINT_SECS * 1000000LL;
+    signal(SIGINT, search_sigint);
+    int nthreads = omp_get_max_threads();
+    s->nthreads = nthreads;
+    void *stats;
+    if (posix_memalign(&stats, 64, nthreads * sizeof(*s->stats))) {
+        fprintf(stderr, "prospector: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    s->stats = memset(stats, 0, nthreads * sizeof(*s->stats));
+    if (s->nrngs < nthreads) {
+        uint64_t (*rngs)[2] = xcalloc(nthreads, sizeof(*rngs));
+        for (int i = 0; i < nthreads; i++) {
+            if (i < s->nrngs) {
+                rngs[i][0] = s->rngs[i][0];
+                rngs[i][1] = s->rngs[i][1];
+            } else {
+                rngs[i][0] = sample64(seed, 2*i + 0);
+                rngs[i][1] = sample64(seed, 2*i + 1);
+            }
+        }
+        free(s->rngs);
+        s->rngs = rngs;
+        s->nrngs = nthreads;
+    }
+    s->start = uepoch();
+    if (report_interval || s->metrics) {
+        long interval = report_interval ? report_interval : 10;
+        s->next_report = s->start + interval * 1000000LL;
+    }
+    if (s->verifiers < 0)
+        s->verifiers = nthreads > 1 ? (nthreads + 3) / 4 : 0;
+    if (s->verifiers >= nthreads)
+        s->verifiers = nthreads - 1;
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int id = omp_get_thread_num();
+        void *buf = execbuf_alloc();
+        uint64_t r[2] = {s->rngs[id][0], s->rngs[id][1]};
+        struct stats *st = s->stats + id;
+        if (id < s->verifiers) {
+            trace_name(id, "verifier");
+            while (!search_stop)
+                if (!search_verify(s, st, buf))
+                    usleep(10000);
+        } else {
+            trace_name(id, "generator");
+            while (!search_stop) {
+                search_generate(s, st, r, buf);
+                if (!s->verifiers)
+                    search_verify(s, st, buf);
+            }
+        }
+    }
+
+    if (s->checkpoint)
+        search_save(s);
+    if (s->next_report)
+        search_report(s, s->npending, s->nboard ? s->board[0].exact : -1);
+    trace_dump();
+}
+
+static void
+exact_sigint(int sig)
+{
+    /* A second interrupt kills the process */
+    signal(sig, SIG_DFL);
+    exact_cancel = 1;
+}
+
+static void
+exact_sigusr1(int sig)
+{
+    signal(sig, exact_sigusr1);
+    exact_report = 1;
+}
+
+static void
+usage(FILE *f)
+{
+    fprintf(f, "usage: prospector "
+            "[-B|D|E|G|L|S|V] [-4|-8] [-eHhMPRs] [-b nsec] [-c a:k] [-C file] "
+            "[-d set] [-I a:b] [-i secs] [-j n] [-K file] [-k n] [-l lib] "
+            "[-m file] [-o file] [-p pattern] [-r n:m] [-T file] [-t x] "
+            "[-W keys:bits:load] [-w n] [-X]\n");
+    fprintf(f, " -4          Generate 32-bit hash functions (default)\n");
+    fprintf(f, " -8          Generate 64-bit hash functions\n");
+    fprintf(f, " -b nsec     Skip functions estimated slower than this\n");
+    fprintf(f, " -c a:k      Stream hashes of a, a+k, a+2k, ... in hex (-G) [0:1]\n");
+    fprintf(f, " -C file     Periodically save progress to a checkpoint file\n");
+    fprintf(f, " -d set      Score input differences: pairs, window:k, or masks\n");
+    fprintf(f, " -e          Measure bias exactly (requires -E)\n");
+    fprintf(f, "             64-bit: over structured 2^32 subdomains\n");
+    fprintf(f, " -H          Also use crc, aes, clmul, and pext operations\n");
+    fprintf(f, " -h          Print this help message\n");
+    fprintf(f, " -I a:b      Enumerate only inputs a through b, in hex (-L)\n");
+    fprintf(f, " -i secs     Report progress and statistics at this interval\n");
+    fprintf(f, " -j n        Inputs hashed per call when scoring (1, 4, 8) [8]\n");
+    fprintf(f, " -K file     Score over keys from a file of native-endian words\n");
+    fprintf(f, " -k n        Leaderboard and pending list size [10]\n");
+    fprintf(f, " -l ./lib.so Load hash() and hash_batch() from a shared object\n");
+    fprintf(f, "             or compile them from a C source file (.c)\n");
+    fprintf(f, " -M          Also measure bit independence and correlation (-E)\n");
+    fprintf(f, " -m file     Write search metrics to a Prometheus text file\n");
+    fprintf(f, " -o file     Write a binary table of outputs (-L)\n");
+    fprintf(f, " -P          Search for the Pareto front of latency and bias\n");
+    fprintf(f, " -p pattern  Search only a given pattern\n");
+    fprintf(f, " -q n        Score quality knob (12-30, default: 18)\n");
+    fprintf(f, " -R          Resume from the checkpoint file (requires -C)\n");
+    fprintf(f, " -r n:m      Use between n and m operations [3:6]\n");
+    fprintf(f, " -s          Don't use large constants\n");
+    fprintf(f, " -T file     Write a Chrome trace of each thread's work on exit\n");
+    fprintf(f, " -t x        Initial score threshold [10.0]\n");
+    fprintf(f, " -W k:b:l    Score a table of 2^b slots at load l, keys k: seq,\n");
+    fprintf(f, "             stride=k (hex, nonzero), cluster, or file (-K)\n");
+    fprintf(f, " -w n        Threads verifying candidates exactly [1/4]\n");
+    fprintf(f, " -X          Interpret functions instead of JIT compiling\n");
+    fprintf(f, " -E          Single evaluation mode (requires -p or -l)\n");
+    fprintf(f, " -S          Hash function search mode (default)\n");
+    fprintf(f, " -G          Stream raw outputs to stdout (requires -p or -l)\n");
+    fprintf(f, " -L          Enumerate output mode (requires -p or -l)\n");
+    fprintf(f, " -V          Verify bijectivity and unhash() (requires -p or -l)\n");
+    fprintf(f, " -D          Decompose a permutation into cycles (requires -p or -l)\n");
+    fprintf(f, " -B          Benchmark latency and throughput (requires -p or -l)\n");
+}
+
+#define BENCH_N      (1L << 20)  // hashes per repetition
+#define BENCH_REPS   21
+#define BENCH_WARMUP 3
+
+/* Keeps the benchmarked results alive. */
+static volatile uint64_t bench_sink;
+
+/* Each benchmark loop calls the hash n times. Latency loops feed each
+ * output into the next call, so calls can't overlap. Throughput loops
+ * hash a block of independent inputs, which the CPU may overlap.
+ */
+typedef void (*bench_loop)(void *f, long n);
+
+static void
+bench_latency32(void *f, long n)
+{
+    uint32_t ABI (*hash)(uint32_t) = f;
+    uint32_t h = 0;
+    for (long i = 0; i < n; i++)
+        h = hash(h);
+    bench_sink = h;
+}
+
+static void
+bench_throughput32(void *f, long n)
+{
+    uint32_t ABI (*hash)(uint32_t) = f;
+    uint32_t acc = 0;
+    for (long i = 0; i < n; i += SAMPLE_BLOCK)
+        for (int j = 0; j < SAMPLE_BLOCK; j++)
+            acc += hash(i + j);
+    bench_sink = acc;
+}
+
+static void
+bench_latency64(void *f, long n)
+{
+    uint64_t ABI (*hash)(uint64_t) = f;
+    uint64_t h = 0;
+    for (long i = 0; i < n; i++)
+        h = hash(h);
+    bench_sink = h;
+}
+
+static void
+bench_throughput64(void *f, long n)
+{
+    uint64_t ABI (*hash)(uint64_t) = f;
+    uint64_t acc = 0;
+    for (long i = 0; i < n; i += SAMPLE_BLOCK)
+        for (int j = 0; j < SAMPLE_BLOCK; j++)
+            acc += hash(i + j);
+    bench_sink = acc;
+}
+
+/* Batch loops hash blocks of independent inputs through the batched
+ * function, as scoring does.
+ */
+static void
+bench_batch32(void *batch, long n)
+{
+    uint32_t v[SAMPLE_BLOCK];
+    uint32_t acc = 0;
+    for (long i = 0; i < n; i += SAMPLE_BLOCK) {
+        for (int j = 0; j < SAMPLE_BLOCK; j++)
+            v[j] = i + j;
+        hash32_n(0, batch, v, SAMPLE_BLOCK);
+        acc += v[SAMPLE_BLOCK - 1];
+    }
+    bench_sink = acc;
+}
+
+static void
+bench_batch64(void *batch, long n)
+{
+    uint64_t v[SAMPLE_BLOCK];
+    uint64_t acc = 0;
+    for (long i = 0; i < n; i += SAMPLE_BLOCK) {
+        for (int j = 0; j < SAMPLE_BLOCK; j++)
+            v[j] = i + j;
+        hash64_n(0, batch, v, SAMPLE_BLOCK);
+        acc += v[SAMPLE_BLOCK - 1];
+    }
+    bench_sink = acc;
+}
+
+/* Open a counter group of user-space cycles and instructions on this
+ * thread. Returns -1, with a message, if the kernel doesn't permit it
+ * (e.g. perf_event_paranoid, containers, virtual machines).
+ */
+static int
+bench_perf_open(int *fds)
+{
+    static const unsigned long long configs[] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    };
+    for (int i = 0; i < 2; i++) {
+        struct perf_event_attr attr = {
+            .type = PERF_TYPE_HARDWARE,
+            .size = sizeof(attr),
+            .config = configs[i],
+            .disabled = i == 0,
+            .read_format = PERF_FORMAT_GROUP,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+        };
+        int group = i ? fds[0] : -1;
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+        if (fds[i] < 0) {
+            fprintf(stderr, "prospector: hardware counters unavailable: "
+                    "%s\n", strerror(errno));
+            if (i)
+                close(fds[0]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+bench_cmp(const void *pa, const void *pb)
+{
+    double a = *(double *)pa;
+    double b = *(double *)pb;
+    return (a > b) - (a < b);
+}
+
+/* Time BENCH_REPS repetitions of a loop after BENCH_WARMUP untimed
+ * ones, and print per-hash statistics. Each repetition is timed with
+ * both the monotonic clock and the TSC. Hardware counters, when open,
+ * cover all timed repetitions.
+ */
+static void
+bench_run(const char *name, bench_loop loop, void *f, const int *fds)
+{
+    double ns[BENCH_REPS];
+    double ticks[BENCH_REPS];
+    for (int i = 0; i < BENCH_WARMUP; i++)
+        loop(f, BENCH_N);
+    if (fds) {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    for (int i = 0; i < BENCH_REPS; i++) {
+        uint64_t t0 = nsclock();
+        uint64_t c0 = __builtin_ia32_rdtsc();
+        loop(f, BENCH_N);
+        uint64_t c1 = __builtin_ia32_rdtsc();
+        uint64_t t1 = nsclock();
+        ns[i] = (double)(t1 - t0) / BENCH_N;
+        ticks[i] = (double)(c1 - c0) / BENCH_N;
+    }
+    if (fds)
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    double mean = 0, var = 0;
+    for (int i = 0; i < BENCH_REPS; i++)
+        mean += ns[i] / BENCH_REPS;
+    for (int i = 0; i < BENCH_REPS; i++)
+        var += (ns[i] - mean) * (ns[i] - mean) / (BENCH_REPS - 1);
+    qsort(ns, BENCH_REPS, sizeof(*ns), bench_cmp);
+    qsort(ticks, BENCH_REPS, sizeof(*ticks), bench_cmp);
+    printf("%-10s = %.3f nsec / hash (median of %d, min %.3f, "
+           "stddev %.3f)\n", name, ns[BENCH_REPS / 2], BENCH_REPS,
+           ns[0], sqrt(var));
+    printf("%-10s = %.2f TSC ticks / hash (median)\n",
+           name, ticks[BENCH_REPS / 2]);
+
+    uint64_t counts[3];  // nr, cycles, instructions
+    if (fds && read(fds[0], counts, sizeof(counts)) == sizeof(counts)) {
+        double n = (double)BENCH_N * BENCH_REPS;
+        printf("%-10s = %.2f cycles, %.2f instructions / hash, "
+               "IPC %.2f\n", name, counts[1] / n, counts[2] / n,
+               counts[1] ? (double)counts[2] / counts[1] : 0.0);
+    }
+}
+
+/* Benchmark the latency and throughput of a single hash function, and
+ * the throughput of its batched form, if any.
+ */
+static void
+bench(void *f, void *batch, int flags)
+{
+    int fds[2];
+    int *perf = bench_perf_open(fds) ? 0 : fds;
+    if (flags & F_U64) {
+        bench_run("latency", bench_latency64, f, perf);
+        bench_run("throughput", bench_throughput64, f, perf);
+        if (batch)
+            bench_run("batch", bench_batch64, batch, perf);
+    } else {
+        bench_run("latency", bench_latency32, f, perf);
+        bench_run("throughput", bench_throughput32, f, perf);
+        if (batch)
+            bench_run("batch", bench_batch32, batch, perf);
+    }
+    if (perf) {
+        close(fds[1]);
+        close(fds[0]);
+    }
+}
+
+#define LIST_CHUNK (1L << 16)  // inputs per -L work unit
+
+/* Hash the inputs of chunk c of [first, last] into v, returning the
+ * number of inputs hashed.
+ */
+static long
+list_chunk(void *f, void *batch, int flags, uint64_t first, uint64_t last,
+           uint64_t c, void *v)
+{
+    uint64_t beg = first + c * LIST_CHUNK;
+    uint64_t rem = last - beg;
+    long n = rem < LIST_CHUNK ? (long)rem + 1 : LIST_CHUNK;
+    if (flags & F_U64) {
+        uint64_t *h = v;
+        for (long j = 0; j < n; j++)
+            h[j] = beg + j;
+        hash64_n(f, batch, h, n);
+    } else {
+        uint32_t *h = v;
+        for (long j = 0; j < n; j++)
+            h[j] = beg + j;
+        hash32_n(f, batch, h, n);
+    }
+    return n;
+}
+
+static char *
+list_hex(char *p, uint64_t x, int digits)
+{
+    for (int i = digits - 1; i >= 0; i--, x >>= 4)
+        p[i] = "0123456789abcdef"[x & 15];
+    return p + digits;
+}
+
+/* Print a function's outputs for inputs [first, last] as text, one
+ * "input output" pair per line. Chunks are hashed and formatted in
+ * parallel, then written in order.
+ */
+static void
+list_text(void *f, void *batch, int flags, uint64_t first, uint64_t last)
+{
+    int digits = flags & F_U64 ? 16 : 8;
+    uint64_t nchunks = (last - first) / LIST_CHUNK + 1;
+
+    #pragma omp parallel
+    {
+        uint64_t *h = malloc(LIST_CHUNK * sizeof(*h));
+        char *text = malloc(LIST_CHUNK * (2 * digits + 2));
+        if (!h || !text) {
+            fprintf(stderr, "prospector: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        #pragma omp for ordered schedule(static, 1)
+        for (uint64_t c = 0; c < nchunks; c++) {
+            long n = list_chunk(f, batch, flags, first, last, c, h);
+            uint64_t beg = first + c * LIST_CHUNK;
+            char *p = text;
+            for (long j = 0; j < n; j++) {
+                uint64_t y = flags & F_U64 ? h[j] : ((uint32_t *)h)[j];
+                p = list_hex(p, beg + j, digits);
+                *p++ = ' ';
+                p = list_hex(p, y, digits);
+                *p++ = '\n';
+            }
+            #pragma omp ordered
+            if (!fwrite(text, p - text, 1, stdout)) {
+                fprintf(stderr, "prospector: write failed: %s\n",
+                        strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        free(text);
+        free(h);
+    }
+    fflush(stdout);
+}
+
+/* Write a function's outputs for inputs [first, last] to a file as a
+ * table of native (little endian) words, hashed and written in
+ * parallel chunks at their final offsets.
+ */
+static void
+list_binary(void *f, void *batch, int flags, uint64_t first, uint64_t last,
+            const char *path)
+{
+    size_t size = flags & F_U64 ? 8 : 4;
+    uint64_t nchunks = (last - first) / LIST_CHUNK + 1;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1 || ftruncate(fd, (last - first + 1) * size)) {
+        fprintf(stderr, "prospector: %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    #pragma omp parallel
+    {
+        uint64_t *h = malloc(LIST_CHUNK * sizeof(*h));
+        if (!h) {
+            fprintf(stderr, "prospector: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (uint64_t c = 0; c < nchunks; c++) {
+            long n = list_chunk(f, batch, flags, first, last, c, h);
+            char *p = (char *)h;
+            size_t len = n * size;
+            off_t off = c * LIST_CHUNK * size;
+            while (len) {
+                ssize_t r = pwrite(fd, p, len, off);
+                if (r < 0) {
+                    fprintf(stderr, "prospector: %s: %s\n",
+                            path, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                p += r;
+                off += r;
+                len -= r;
+            }
+        }
+
+        free(h);
+    }
+    if (close(fd)) {
+        fprintf(stderr, "prospector: %s: %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+#define VERIFY_PREFETCH 32  // bitmap prefetch distance, in outputs
+
+/* First failure found by verify_run(), if any. */
+static struct {
+    enum {VERIFY_OK, VERIFY_COLLISION, VERIFY_UNHASH} kind;
+    uint64_t x, y, u;
+} verify_failure;
+
+static void
+verify_fail(int kind, uint64_t x, uint64_t y, uint64_t u)
+{
+    #pragma omp critical(verify)
+    if (!verify_failure.kind) {
+        verify_failure.x = x;
+        verify_failure.y = y;
+        verify_failure.u = u;
+        __atomic_store_n(&verify_failure.kind, kind, __ATOMIC_RELAXED);
+    }
+}
+
+/* Find an input other than x that a 32-bit function maps to y. */
+static uint32_t
+verify_preimage(void *f, void *batch, uint32_t x, uint32_t y)
+{
+    uint32_t found = x;
+    long nchunks = (1L << 32) / LIST_CHUNK;
+    #pragma omp parallel
+    {
+        uint32_t *h = malloc(LIST_CHUNK * sizeof(*h));
+        if (!h) {
+            fprintf(stderr, "prospector: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        #pragma omp for schedule(dynamic)
+        for (long c = 0; c < nchunks; c++) {
+            if (__atomic_load_n(&found, __ATOMIC_RELAXED) != x)
+                continue;
+            list_chunk(f, batch, 0, 0, 0xffffffff, c, h);
+            for (long j = 0; j < LIST_CHUNK; j++)
+                if (h[j] == y && c * LIST_CHUNK + j != x)
+                    __atomic_store_n(&found, c * LIST_CHUNK + j,
+                                     __ATOMIC_RELAXED);
+        }
+        free(h);
+    }
+    return found;
+}
+
+/* Check a function over 2^32 inputs in parallel: that a 32-bit function
+ * is a permutation, by marking its outputs in a 2^32-bit (512 MiB)
+ * bitmap, and that unhash(), if given, inverts it. A 64-bit function
+ * can only be checked against unhash(), over 2^32 sampled inputs.
+ * Stops at the first failure, and prints the result.
+ */
+static int
+verify_run(void *f, void *batch, void *unhash, int flags)
+{
+    int u64 = flags & F_U64;
+    long nchunks = (1L << 32) / LIST_CHUNK;
+    size_t bitmap_size = (size_t)1 << 29;
+    uint64_t *bitmap = 0;
+    if (!u64) {
+        bitmap = mmap(NULL, bitmap_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (bitmap == MAP_FAILED) {
+            fprintf(stderr, "prospector: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+#ifdef MADV_HUGEPAGE
+        /* Nearly every access is random, so spare the TLB */
+        madvise(bitmap, bitmap_size, MADV_HUGEPAGE);
+#endif
+    }
+
+    #pragma omp parallel
+    {
+        uint64_t *x = malloc(LIST_CHUNK * sizeof(*x));
+        uint64_t *h = malloc(LIST_CHUNK * sizeof(*h));
+        if (!x || !h) {
+            fprintf(stderr, "prospector: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (long c = 0; c < nchunks; c++) {
+            if (__atomic_load_n(&verify_failure.kind, __ATOMIC_RELAXED))
+                continue;
+            if (u64) {
+                uint64_t ABI (*inv)(uint64_t) = unhash;
+                for (long j = 0; j < LIST_CHUNK; j++)
+                    h[j] = x[j] = sample64(0, c * LIST_CHUNK + j);
+                hash64_n(f, batch, h, LIST_CHUNK);
+                for (long j = 0; j < LIST_CHUNK; j++) {
+                    uint64_t u = inv(h[j]);
+                    if (u != x[j])
+                        verify_fail(VERIFY_UNHASH, x[j], h[j], u);
+                }
+                continue;
+            }
+
+            uint32_t ABI (*inv)(uint32_t) = unhash;
+            uint32_t *h32 = (uint32_t *)h;
+            list_chunk(f, batch, 0, 0, 0xffffffff, c, h32);
+            for (long j = 0; j < LIST_CHUNK; j++) {
+                uint32_t y = h32[j];
+                long ahead = j + VERIFY_PREFETCH;
+                if (ahead < LIST_CHUNK)
+                    __builtin_prefetch(bitmap + (h32[ahead] >> 6));
+                uint64_t bit = UINT64_C(1) << (y & 63);
+                uint64_t old = __atomic_fetch_or(bitmap + (y >> 6), bit,
+                                                 __ATOMIC_RELAXED);
+                if (old & bit)
+                    verify_fail(VERIFY_COLLISION, c * LIST_CHUNK + j, y, 0);
+                if (inv && inv(y) != c * LIST_CHUNK + j)
+                    verify_fail(VERIFY_UNHASH, c * LIST_CHUNK + j, y,
+                                inv(y));
+            }
+        }
+
+        free(h);
+        free(x);
+    }
+    if (bitmap)
+        munmap(bitmap, bitmap_size);
+
+    int digits = u64 ? 16 : 8;
+    switch (verify_failure.kind) {
+        case VERIFY_OK:
+            if (!u64)
+                puts("bijective  = yes");
+            if (unhash)
+                printf("round trip = ok%s\n", u64 ? " (2^32 samples)" : "");
+            return 0;
+        case VERIFY_COLLISION:
+            printf("bijective  = no, hash(%0*llx) = hash(%0*llx) = %0*llx\n",
+                   digits, (unsigned long long)verify_failure.x,
+                   digits, (unsigned long long)
+                       verify_preimage(f, batch, verify_failure.x,
+                                       verify_failure.y),
+                   digits, (unsigned long long)verify_failure.y);
+            return -1;
+        case VERIFY_UNHASH:
+            printf("round trip = failed, unhash(hash(%0*llx)) = "
+                   "unhash(%0*llx) = %0*llx\n",
+                   digits, (unsigned long long)verify_failure.x,
+                   digits, (unsigned long long)verify_failure.y,
+                   digits, (unsigned long long)verify_failure.u);
+            return -1;
+    }
+    abort();
+}
+
+#define CYCLE_AHEAD 16  // outputs computed ahead of a walk, power of 2
+
+/* A permutation only leaves segments where walks meet on a cycle, a
+ * number which grows with threads, not inputs. Functions that aren't
+ * permutations instead leave one per walk, and hit this limit.
+ */
+#define CYCLE_MAX_SEGS (1L << 22)
+
+/* Part of a cycle walked by one thread: len elements from start, up to
+ * but not including next, which another walk started from.
+ */
+struct cycle_seg {
+    uint32_t start, next;
+    uint64_t len;
+};
+
+static int
+cycle_seg_cmp(const void *pa, const void *pb)
+{
+    const struct cycle_seg *a = pa;
+    const struct cycle_seg *b = pb;
+    return (a->start > b->start) - (a->start < b->start);
+}
+
+/* Cycle statistics, merged across threads. Bucket i of the histogram
+ * counts cycles with lengths in [2^i, 2^(i+1)).
+ */
+struct cycle_stats {
+    uint64_t count;
+    uint64_t shortest;
+    uint64_t longest;
+    uint64_t cycles[33];
+    uint64_t elements[33];
+};
+
+static void
+cycle_add(struct cycle_stats *s, uint64_t len)
+{
+    int i = 63 - __builtin_clzll(len);
+    s->count++;
+    s->cycles[i]++;
+    s->elements[i] += len;
+    if (!s->shortest || len < s->shortest)
+        s->shortest = len;
+    if (len > s->longest)
+        s->longest = len;
+}
+
+/* Decompose a 32-bit permutation into cycles and print their
+ * statistics. Threads start walks from unvisited inputs, claiming each
+ * element in a shared 2^32-bit bitmap as they go. A walk that returns
+ * to its start is a whole cycle. One that reaches an element claimed
+ * by another walk stops there, and since claimed runs are contiguous,
+ * that element is the other walk's start. Those segments are stitched
+ * into cycles at the end. Outputs are computed a few steps ahead of
+ * each walk so their bitmap words can be prefetched.
+ */
+static int
+cycle_run(void *f, void *batch)
+{
+    size_t bitmap_size = (size_t)1 << 29;
+    uint64_t *bitmap = mmap(NULL, bitmap_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bitmap == MAP_FAILED) {
+        fprintf(stderr, "prospector: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(bitmap, bitmap_size, MADV_HUGEPAGE);
+#endif
+
+    struct cycle_stats stats = {0};
+    struct cycle_seg *segs = 0;
+    size_t nsegs = 0, capsegs = 0;
+    long nchunks = (1L << 32) / LIST_CHUNK;
+
+    #pragma omp parallel
+    {
+        struct cycle_stats local = {0};
+
+        #pragma omp for schedule(dynamic)
+        for (long c = 0; c < nchunks; c++) {
+            for (long j = 0; j < LIST_CHUNK; j++) {
+                uint32_t s = c * LIST_CHUNK + j;
+                uint64_t bit = UINT64_C(1) << (s & 63);
+                if (__atomic_load_n(bitmap + (s >> 6), __ATOMIC_RELAXED) & bit)
+                    continue;
+                if (__atomic_fetch_or(bitmap + (s >> 6), bit,
+                                      __ATOMIC_RELAXED) & bit)
+                    continue;
+
+                uint32_t ring[CYCLE_AHEAD];
+                int head = 0, n = 0;
+                uint32_t last = s;
+                uint64_t len = 1;
+                for (;;) {
+                    /* Ramp up slowly so short cycles waste little */
+                    for (int k = 0; k < 2 && n < CYCLE_AHEAD; k++) {
+                        hash32_n(f, batch, &last, 1);
+                        __builtin_prefetch(bitmap + (last >> 6));
+                        ring[(head + n++) % CYCLE_AHEAD] = last;
+                    }
+                    uint32_t y = ring[head];
+                    head = (head + 1) % CYCLE_AHEAD;
+                    n--;
+
+                    if (y == s) {
+                        cycle_add(&local, len);
+                        break;
+                    }
+                    bit = UINT64_C(1) << (y & 63);
+                    if (__atomic_fetch_or(bitmap + (y >> 6), bit,
+                                          __ATOMIC_RELAXED) & bit) {
+                        #pragma omp critical(cycles)
+                        {
+                            if (nsegs == CYCLE_MAX_SEGS) {
+                                fprintf(stderr, "prospector: not a "
+                                        "permutation (see -V)\n");
+                                exit(EXIT_FAILURE);
+                            }
+                            if (nsegs == capsegs) {
+                                capsegs = capsegs ? 2 * capsegs : 64;
+                                segs = realloc(segs,
+                                               capsegs * sizeof(*segs));
+                                if (!segs) {
+                                    fprintf(stderr, "prospector: "
+                                            "out of memory\n");
+                                    exit(EXIT_FAILURE);
+                                }
+                            }
+                            segs[nsegs++] = (struct cycle_seg){s, y, len};
+                        }
+                        break;
+                    }
+                    len++;
+                }
+            }
+        }
+
+        #pragma omp critical(cycles)
+        {
+            stats.count += local.count;
+            for (int i = 0; i < 33; i++) {
+                stats.cycles[i] += local.cycles[i];
+                stats.elements[i] += local.elements[i];
+            }
+            if (local.shortest &&
+                (!stats.shortest || local.shortest < stats.shortest))
+                stats.shortest = local.shortest;
+            if (local.longest > stats.longest)
+                stats.longest = local.longest;
+        }
+    }
+    munmap(bitmap, bitmap_size);
+
+    /* Stitch segments into cycles, marking each used by zeroing len */
+    qsort(segs, nsegs, sizeof(*segs), cycle_seg_cmp);
+    for (size_t i = 0; i < nsegs; i++) {
+        if (!segs[i].len)
+            continue;
+        uint64_t len = 0;
+        struct cycle_seg *p = segs + i;
+        do {
+            struct cycle_seg key = {.start = p->next};
+            len += p->len;
+            p->len = 0;
+            p = bsearch(&key, segs, nsegs, sizeof(*segs), cycle_seg_cmp);
+            if (!p || (!p->len && p != segs + i)) {
+                fprintf(stderr, "prospector: not a permutation (see -V)\n");
+                exit(EXIT_FAILURE);
+            }
+        } while (p != segs + i);
+        cycle_add(&stats, len);
+    }
+    free(segs);
+
+    printf("cycles    = %llu\n", (unsigned long long)stats.count);
+    printf("shortest  = %llu\n", (unsigned long long)stats.shortest);
+    printf("longest   = %llu\n", (unsigned long long)stats.longest);
+    for (int i = 0; i < 33; i++)
+        if (stats.cycles[i])
+            printf("log2 %-4d = %llu cycles, %llu elements\n", i,
+                   (unsigned long long)stats.cycles[i],
+                   (unsigned long long)stats.elements[i]);
+    return 0;
+}
+
+#define STREAM_BLOCK (1L << 16)  // words per write in -G mode
+
+/* Write hash(seed + i*stride) for i = 0, 1, 2, ... to standard output
+ * as raw native words, until the reader goes away.
+ */
+static void
+stream_run(void *f, void *batch, int flags, uint64_t seed, uint64_t stride)
+{
+    size_t size = flags & F_U64 ? 8 : 4;
+    uint64_t *h = malloc(STREAM_BLOCK * sizeof(*h));
+    if (!h) {
+        fprintf(stderr, "prospector: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint64_t c = seed;;) {
+        if (flags & F_U64) {
+            for (long j = 0; j < STREAM_BLOCK; j++, c += stride)
+                h[j] = c;
+            hash64_n(f, batch, h, STREAM_BLOCK);
+        } else {
+            uint32_t *h32 = (uint32_t *)h;
+            for (long j = 0; j < STREAM_BLOCK; j++, c += stride)
+                h32[j] = c;
+            hash32_n(f, batch, h32, STREAM_BLOCK);
+        }
+        char *p = (char *)h;
+        for (size_t len = STREAM_BLOCK * size; len;) {
+            ssize_t r = write(STDOUT_FILENO, p, len);
+            if (r < 0) {
+                if (errno == EPIPE)
+                    exit(EXIT_SUCCESS);
+                fprintf(stderr, "prospector: write failed: %s\n",
+                        strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            p += r;
+            len -= r;
+        }
+    }
+}
+
+#define CALIBRATE_OPS 16  // operations per calibration function
+
+/* Time chained calls of a JIT-compiled function, in nanoseconds per
+ * call. The best of several repetitions rejects interruptions. An
+ * interpreted function is timed over blocks of inputs instead.
+ */
+static double
+hf_time(const struct hf_op *ops, int n, int flags, void *buf)
+{
+    double best = HUGE_VAL;
+    union {
+        uint32_t u32[SAMPLE_BLOCK];
+        uint64_t u64[SAMPLE_BLOCK];
+    } v = {{0}};
+    hf_compile(ops, n, buf);
+    execbuf_lock(buf);
+    for (int r = 0; r < BENCH_WARMUP + 5; r++) {
+        uint64_t t0 = nsclock();
+        if (hf_interpret) {
+            for (long i = 0; i < BENCH_N / 16; i += SAMPLE_BLOCK) {
+                if (flags & F_U64)
+                    hf_run64(buf, v.u64, SAMPLE_BLOCK);
+                else
+                    hf_run32(buf, v.u32, SAMPLE_BLOCK);
+            }
+        } else if (flags & F_U64) {
+            bench_latency64(buf, BENCH_N / 16);
+        } else {
+            bench_latency32(buf, BENCH_N / 16);
+        }
+        double ns = (double)(nsclock() - t0) / (BENCH_N / 16);
+        if (r >= BENCH_WARMUP && ns < best)
+            best = ns;
+    }
+    execbuf_unlock(buf);
+    return best;
+}
+
+/* Calibrate the latency cost model by timing a chain of each type of
+ * operation, as encoded by the JIT, against an empty function. The
+ * hardware operations are only timed with -H or when the template
+ * (ops, or null) uses them, since the CPU might lack the rest.
+ */
+static void
+hf_calibrate(int flags, const struct hf_op *template, int nops, void *buf)
+{
+    enum hf_type first = flags & F_U64 ? HF64_XOR : HF32_XOR;
+    enum hf_type last = HF32_PEXT;
+    uint64_t rng[2] = {0x2a2bc037b59ff989, 0x6d7db86fa2f632ca};
+    struct hf_op ops[CALIBRATE_OPS];
+    int timed[HF64_PEXT + 1] = {0};
+
+    /* An empty function still needs one operation for its type */
+    ops[0].type = first;
+    ops[0].constant = 0;
+    hf_overhead = hf_time(ops, 1, flags, buf);
+    if (flags & F_U64)
+        last += HF64_XOR;
+    for (enum hf_type t = first; t <= last; t++) {
+        timed[t] = flags & F_HW || t % HF64_XOR <= HF32_SUBL;
+        for (int i = 0; template && i < nops; i++)
+            timed[t] |= template[i].type == t;
+        if (!timed[t])
+            continue;
+        for (int i = 0; i < CALIBRATE_OPS; i++) {
+            ops[i].type = t;
+            hf_randomize(ops + i, rng);
+        }
+        double ns = hf_time(ops, CALIBRATE_OPS, flags, buf);
+        hf_costs[t] = fmax(0, (ns - hf_overhead) / CALIBRATE_OPS);
+    }
+    hf_overhead = fmax(0, hf_overhead - hf_costs[first]);
+
+    printf("// latency model (nsec): call %.3f", hf_overhead);
+    for (enum hf_type t = first; t <= last; t++)
+        if (timed[t])
+            printf(", %s %.3f", hf_names[t] + 2, hf_costs[t]);
+    printf("\n");
+}
+
+/* Compile a C source file defining hash() into a shared object for
+ * load_function(), returning its path. A prospector_batch() is
+ * appended to the translation unit so that the compiler inlines hash()
+ * into a loop, and vectorizes it if it can. It stands in for
+ * hash_batch() when the source doesn't define one.
+ * Objects are cached in a private $XDG_CACHE_HOME/prospector directory
+ * (default ~/.cache/prospector) by the hash of the compiler, source and
+ * width, so only the first run pays for compilation.
+ */
+static char *
+compile_function(const char *src, int flags)
+{
+    static const char batch[] =
+        "\n#line 1 \"<prospector>\"\n"
+        "#include <stddef.h>\n"
+        "__attribute__((sysv_abi))\n"
+        "void\n"
+        "prospector_batch(const uint%d_t *in, uint%d_t *out, size_t n)\n"
+        "{\n"
+        "    for (size_t i = 0; i < n; i++)\n"
+        "        out[i] = hash(in[i]);\n"
+        "}\n";
+    static char path[4096];
+    int bits = flags & F_U64 ? 64 : 32;
+
+    FILE *f = fopen(src, "rb");
+    if (!f) {
+        fprintf(stderr, "prospector: could not open %s\n", src);
+        exit(EXIT_FAILURE);
+    }
+    size_t len = 0, cap = 1 << 12;
+    char *text = malloc(cap);
+    for (size_t r; text && (r = fread(text + len, 1, cap - len - 1, f));) {
+        len += r;
+        if (len + 1 == cap)
+            text = realloc(text, cap *= 2);
+    }
+    if (!text || ferror(f)) {
+        fprintf(stderr, "prospector: could not read %s\n", src);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+    text[len] = 0;
+
+    /* FNV-1a over the compiler and source, tagged with the width */
+    const char *cc = getenv("CC");
+    cc = cc ? cc : "cc";
+    uint64_t h = 0xcbf29ce484222325 ^ bits;
+    for (size_t i = 0; i <= strlen(cc); i++)
+        h = (h ^ (unsigned char)cc[i]) * 0x100000001b3;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)text[i]) * 0x100000001b3;
+
+    /* Only we can write to the cache, so a cached library is trusted */
+    char dir[sizeof(path) - 32];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg) {
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    } else if (home && *home) {
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    } else {
+        fprintf(stderr, "prospector: no cache directory for %s "
+                "(set $XDG_CACHE_HOME or $HOME)\n", src);
+        exit(EXIT_FAILURE);
+    }
+    mkdir(dir, 0700);
+    size_t dirlen = strlen(dir);
+    snprintf(dir + dirlen, sizeof(dir) - dirlen, "/prospector");
+    mkdir(dir, 0700);
+    struct stat st;
+    if (lstat(dir, &st)) {
+        fprintf(stderr, "prospector: could not create %s: %s\n",
+                dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() || st.st_mode & 022) {
+        fprintf(stderr, "prospector: cache directory %s is not private\n",
+                dir);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(path, sizeof(path), "%s/%016llx.so",
+             dir, (unsigned long long)h);
+    if (!lstat(path, &st) && S_ISREG(st.st_mode) &&
+            st.st_uid == geteuid()) {
+        free(text);
+        return path;
+    }
+
+    /* Compile to a private name, then rename it into place */
+    char part[sizeof(path) + 32];
+    char cmd[2 * sizeof(path)];
+    snprintf(part, sizeof(part), "%s.%ld", path, (long)getpid());
+    snprintf(cmd, sizeof(cmd),
+             "%s -O3 -march=native -shared -fPIC -x c -o '%s' -",
+             cc, part);
+    FILE *p = popen(cmd, "w");
+    if (!p) {
+        fprintf(stderr, "prospector: could not run %s\n", cmd);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(p, "#line 1 \"%s\"\n%s", src, text);
+    fprintf(p, batch, bits, bits);
+    if (pclose(p) || rename(part, path)) {
+        fprintf(stderr, "prospector: failed to compile %s\n", src);
+        remove(part);
+        exit(EXIT_FAILURE);
+    }
+    free(text);
+    return path;
+}
+
+/* Load hash() from a shared object, and its optional batched form,
+ * hash_batch(in, out, n), into *batch (null if absent). A library
+ * compiled from source falls back on its generated prospector_batch().
+ */
+static void *
+load_function(const char *so, void **batch)
+{
+    void *handle = dlopen(so, RTLD_NOW);
+    if (!handle) {
+        fprintf(stderr, "prospector: could not load %s\n", so);
+        exit(EXIT_FAILURE);
+    }
+    void *f = dlsym(handle, "hash");
+    if (!f) {
+        fprintf(stderr, "prospector: could not find 'hash' in %s\n", so);
+        exit(EXIT_FAILURE);
+    }
+    *batch = dlsym(handle, "hash_batch");
+    if (!*batch)
+        *batch = dlsym(handle, "prospector_batch");
+    lib_batch = !!*batch;
+    return f;
+}
+
+/* Prepare checkpointing for an exact measurement of either a template
+ * function (ops) or a library function (lib). When resuming, a template
+ * function takes its constants from the checkpoint.
+ */
+static void
+exact_ckpt_init(struct exact_ckpt *ck, const char *path, int resume,
+                int flags, struct hf_op *ops, int nops, const char *lib)
+{
+    char want[sizeof(ck->function)];
+    if (ops) {
+        char buf[TEMPLATE_MAX];
+        hf_template(ops, nops, buf);
+        snprintf(want, sizeof(want), "pattern %s", buf);
+    } else {
+        snprintf(want, sizeof(want), "library %s", lib);
+    }
+    ck->path = path;
+    ck->bits = flags & F_U64 ? 64 : 32;
+    ck->npass = flags & F_U64 ? EXACT64_SUBDOMAINS : 1;
+    ck->size = bins_rows(ck->bits) * ck->bits;
+    strcpy(ck->function, want);
+    if (!resume)
+        return;
+
+    int match = 0;
+    switch (exact_ckpt_load(ck)) {
+        case 0:
+            fprintf(stderr, "prospector: no checkpoint at %s, starting over\n",
+                    path);
+            return;
+        case -1:
+            fprintf(stderr, "prospector: invalid checkpoint: %s\n", path);
+            exit(EXIT_FAILURE);
+        case 1:
+            if (ops && !strncmp(ck->function, "pattern ", 8)) {
+                struct hf_op saved[32];
+                char buf[sizeof(ck->function)];
+                strcpy(buf, ck->function + 8);
+                match = parse_template(saved, countof(saved), buf, flags) == nops;
+                for (int i = 0; match && i < nops; i++) {
+                    match = saved[i].type == ops[i].type &&
+                        (!(ops[i].flags & FOP_LOCKED) ||
+                         saved[i].constant == ops[i].constant);
+                    ops[i].constant = saved[i].constant;
+                }
+            } else if (!ops) {
+                match = !strcmp(ck->function, want);
+            }
+    }
+    if (!match) {
+        fprintf(stderr, "prospector: checkpoint is for another function: %s\n",
+                ck->function);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int nops = 0;
+    int min = 3;
+    int max = 6;
+    int flags = 0;
+    int use_exact = 0;
+    int use_bitstats = 0;
+    char *keyfile = 0;
+    int resume = 0;
+    char *checkpoint = 0;
+    char *metrics = 0;
+    char *tracefile = 0;
+    int pareto = 0;
+    double budget = 0;
+    int nelite = 10;
+    int verifiers = -1;
+    double best = 100.0;
+    int threshold = 0;
+    char *dynamic = 0;
+    char *output = 0;
+    uint64_t list_first = 0;
+    uint64_t list_last = UINT64_MAX;
+    uint64_t stream_seed = 0;
+    uint64_t stream_stride = 1;
+    char *template = 0;
+    struct hf_op ops[32];
+    void *buf = execbuf_alloc();
+    uint64_t rng[2] = {0x2a2bc037b59ff989, 0x6d7db86fa2f632ca};
+
+    enum {
+        MODE_SEARCH, MODE_EVAL, MODE_LIST, MODE_BENCH, MODE_STREAM,
+        MODE_VERIFY, MODE_CYCLES
+    } mode = MODE_SEARCH;
+
+    __builtin_cpu_init();
+    hf_bmi2 = __builtin_cpu_supports("bmi2");
+
+    int option;
+    while ((option = getopt(argc, argv, "48Bb:c:C:Dd:EeGHhI:i:j:K:k:LMl:m:o:Pq:Rr:SsT:t:p:VW:w:X")) != -1) {
+        switch (option) {
+            case '4':
+                flags &= ~F_U64;
+                break;
+            case '8':
+                flags |= F_U64;
+                break;
+            case 'B':
+                mode = MODE_BENCH;
+                break;
+            case 'b':
+                budget = strtod(optarg, 0);
+                if (budget <= 0) {
+                    fprintf(stderr, "prospector: invalid budget (-b): %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'c': {
+                unsigned long long a, b;
+                if (sscanf(optarg, "%llx:%llx", &a, &b) != 2) {
+                    fprintf(stderr, "prospector: invalid counter (-c): "
+                            "%s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                stream_seed = a;
+                stream_stride = b;
+            } break;
+            case 'C':
+                checkpoint = optarg;
+                break;
+            case 'D':
+                mode = MODE_CYCLES;
+                break;
+            case 'd':
+                if (!parse_diffs(optarg)) {
+                    fprintf(stderr, "prospector: invalid differences (-d): "
+                            "%s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'E':
                 mode = MODE_EVAL;
                 break;
             case 'e':
                 use_exact = 1;
                 break;
+            case 'H':
+                flags |= F_HW;
+                break;
             case 'h': usage(stdout);
                 exit(EXIT_SUCCESS);
                 break;
+            case 'i':
+                report_interval = atol(optarg);
+                if (report_interval < 1) {
+                    fprintf(stderr, "prospector: invalid interval (-i): %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                hf_lanes = atoi(optarg);
+                if (hf_lanes != 1 && hf_lanes != 4 && hf_lanes != 8) {
+                    fprintf(stderr, "prospector: invalid lanes (-j): %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'k':
+                nelite = atoi(optarg);
+                if (nelite < 1 || nelite > ELITE_MAX) {
+                    fprintf(stderr, "prospector: invalid size (-k): %s\n",
+                            optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'G':
+                mode = MODE_STREAM;
+                break;
             case 'L':
                 mode = MODE_LIST;
                 break;
             case 'l':
                 dynamic = optarg;
                 break;
+            case 'K':
+                keyfile = optarg;
+                break;
+            case 'M':
+                use_bitstats = 1;
+                break;
+            case 'm':
+                metrics = optarg;
+                break;
+            case 'P':
+                pareto = 1;
+                break;
             case 'p':
                 template = optarg;
                 break;
+            case 'R':
+                resume = 1;
+                break;
+            case 'I': {
+                unsigned long long a, b;
+                if (sscanf(optarg, "%llx:%llx", &a, &b) != 2 || a > b) {
+                    fprintf(stderr, "prospector: invalid input range "
+                            "(-I): %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                list_first = a;
+                list_last = b;
+            } break;
+            case 'o':
+                output = optarg;
+                break;
             case 'r':
                 if (sscanf(optarg, "%d:%d", &min, &max) != 2 ||
                     min < 1 || max > countof(ops) || min > max) {
@@ -839,8 +4772,38 @@ main(int argc, char **argv)
             case 's':
                 flags |= F_TINY;
                 break;
+            case 'T':
+                tracefile = optarg;
+                break;
             case 't':
                 best = strtod(optarg, 0);
+                threshold = 1;
+                break;
+            case 'V':
+                mode = MODE_VERIFY;
+                break;
+            case 'W': {
+                static struct table t;
+                if (!table_parse(&t, optarg)) {
+                    fprintf(stderr, "prospector: invalid workload (-W): "
+                            "%s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                table = &t;
+            } break;
+            case 'w': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (end == optarg || *end || n < 0 || n > INT_MAX) {
+                    fprintf(stderr, "prospector: invalid verifiers (-w): "
+                            "%s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                verifiers = n;
+            } break;
+            case 'X':
+                wxr_enabled = WXR_NOEXEC;
+                hf_interpret = 1;
                 break;
             default:
                 usage(stderr);
@@ -848,6 +4811,13 @@ main(int argc, char **argv)
         }
     }
 
+    /* Settle W^X detection before compiling anything, since it decides
+     * whether functions are compiled at all, and before threads race
+     * to it.
+     */
+    execbuf_lock(buf);
+    execbuf_unlock(buf);
+
     /* Get a unique seed */
     FILE *urandom = fopen("/dev/urandom", "rb");
     if (urandom) {
@@ -866,107 +4836,251 @@ main(int argc, char **argv)
         }
     }
 
+    for (int i = 0; i < 4; i++) {
+        static const enum hf_type hw[] = {
+            HF32_CRC, HF32_AES, HF32_CLMUL, HF32_PEXT
+        };
+        int used = flags & F_HW;
+        for (int j = 0; j < nops; j++)
+            used |= ops[j].type % HF64_XOR == hw[i];
+        if (used && !hf_interpret && !hf_supported(hw[i])) {
+            fprintf(stderr, "prospector: this CPU lacks %s\n",
+                    hf_names[hw[i]] + 2);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (resume && !checkpoint) {
+        fprintf(stderr, "prospector: -R requires -C\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (keyfile)
+        keys_load(keyfile, flags & F_U64 ? 64 : 32);
+
+    if (diff_count && flags & F_U64) {
+        fprintf(stderr, "prospector: -d requires 32-bit functions\n");
+        exit(EXIT_FAILURE);
+    }
+    if (table && (diff_count || use_bitstats)) {
+        fprintf(stderr, "prospector: -W scores tables, not bias (-d, -M)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (table && !threshold)
+        best = 1000.0;  // no worse than random
+    if (table && table->keys == TABLE_STRIDE && !(flags & F_U64) &&
+            !(uint32_t)table->stride) {
+        fprintf(stderr, "prospector: -W stride is zero in 32 bits\n");
+        exit(EXIT_FAILURE);
+    }
+    if (table && table->keys == TABLE_FILE && !nkeys) {
+        fprintf(stderr, "prospector: -W file requires -K\n");
+        exit(EXIT_FAILURE);
+    }
+    if (diff_count && use_bitstats) {
+        fprintf(stderr, "prospector: -M measures single-bit flips, not -d\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (tracefile)
+        trace_init(tracefile, omp_get_max_threads());
+
+    if (dynamic) {
+        size_t len = strlen(dynamic);
+        if (len > 2 && !strcmp(dynamic + len - 2, ".c"))
+            dynamic = compile_function(dynamic, flags);
+    }
+
     if (mode == MODE_EVAL) {
         double bias;
         void *hashptr = 0;
+        void *batchptr = 0;
+        static struct exact_ckpt ck;
+
+        /* Over keys, -e measures every key once rather than enumerating
+         * all inputs.
+         */
+        int all_keys = use_exact && nkeys;
+        long nsamples = all_keys ? nkeys : keys_samples(1L << score_quality);
+        use_exact &= !all_keys;
         if (template) {
             hf_randfunc(ops, nops, rng);
+            if (use_exact && checkpoint)
+                exact_ckpt_init(&ck, checkpoint, resume, flags, ops, nops, 0);
             hf_compile(ops, nops, buf);
             execbuf_lock(buf);
             hashptr = buf;
+            batchptr = hf_batch(buf);
         } else if (dynamic) {
-            hashptr = load_function(dynamic);
+            hashptr = load_function(dynamic, &batchptr);
+            if (use_exact && checkpoint)
+                exact_ckpt_init(&ck, checkpoint, resume, flags, 0, 0, dynamic);
         } else {
             fprintf(stderr, "prospector: must supply -p or -l\n");
             exit(EXIT_FAILURE);
         }
+        if (table) {
+            uint64_t beg = uepoch();
+            long n = table_keys(table);
+            printf("keys      = %ld in %ld slots\n", n, 1L << table->bits);
+            double score = flags & F_U64 ?
+                table_score64(hashptr, batchptr, 1) :
+                table_score32(hashptr, batchptr, 1);
+            printf("table     = %.17g\n", score);
+            printf("speed     = %.3f nsec / key\n",
+                   (uepoch() - beg) * 1000.0 / n);
+            return 0;
+        }
+        if (use_exact && checkpoint)
+            exact_ckpt = &ck;
+        if (use_bitstats) {
+            bitstats = xcalloc(1, sizeof(*bitstats));
+            bitstats->bits = flags & F_U64 ? 64 : 32;
+        }
+        if (use_exact) {
+            exact_verbose = 1;
+            signal(SIGINT, exact_sigint);
+            signal(SIGUSR1, exact_sigusr1);
+        }
 
         uint64_t nhash;
+        double error = -1;
         uint64_t beg = uepoch();
         if (flags & F_U64) {
             uint64_t ABI (*hash)(uint64_t) = hashptr;
-            if (use_exact)
-                fputs("warning: no exact bias for 64-bit\n", stderr);
-            bias = estimate_bias64(hash, rng);
-            nhash = (1L << score_quality) * 33;
+            if (use_exact) {
+                double sub[EXACT64_SUBDOMAINS];
+                bias = exact_bias64(hash, batchptr, sub, &error);
+                nhash = exact_computed * EXACT_RANGE * 65;
+                for (int i = 0; i < EXACT64_SUBDOMAINS; i++) {
+                    int n = countof(exact64_words);
+                    printf("%s %08lx = %.17g\n",
+                           i < n ? "high word" : "low word ",
+                           (unsigned long)exact64_words[i % n], sub[i]);
+                }
+            } else {
+                uint64_t seed = xoroshiro128plus(rng);
+                bias = estimate64(hash, batchptr, seed, nsamples,
+                                  all_keys ? 0 : &error);
+                nhash = nsamples * 65;
+            }
         } else {
             uint32_t ABI (*hash)(uint32_t) = hashptr;
             if (use_exact) {
-                bias = exact_bias32(hash);
-                nhash = (1LL << 32) * 33;
+                bias = exact_bias32(hash, batchptr, &error);
+                nhash = exact_computed * EXACT_RANGE * (bins_rows(32) + 1);
             } else {
-                bias = estimate_bias32(hash, rng);
-                nhash = (1L << score_quality) * 65;
+                uint64_t seed = xoroshiro128plus(rng);
+                bias = estimate32(hash, batchptr, seed, nsamples,
+                                  all_keys ? 0 : &error);
+                nhash = nsamples * (bins_rows(32) + 1);
             }
         }
         uint64_t end = uepoch();
+        trace_dump();
         printf("bias      = %.17g\n", bias);
-        printf("speed     = %.3f nsec / hash\n", (end - beg) * 1000.0 / nhash);
+        if (error >= 0 && (!use_exact || exact_cancel))
+            printf("std error = %.17g\n", error);
+        if (bitstats && bitstats->n)
+            bitstats_print(bitstats);
+        if (nhash)
+            printf("speed     = %.3f nsec / hash\n",
+                   (end - beg) * 1000.0 / nhash);
+        if (exact_cancel) {
+            puts("interrupted, partial result");
+            return EXIT_FAILURE;
+        }
         return 0;
     }
 
-    if (mode == MODE_LIST) {
+    if (mode != MODE_SEARCH) {
         void *hashptr = 0;
+        void *batchptr = 0;
+        void *unhashptr = 0;
         if (template) {
+            if (mode == MODE_BENCH && hf_interpret) {
+                fprintf(stderr, "prospector: -B requires executable "
+                        "memory\n");
+                exit(EXIT_FAILURE);
+            }
             hf_randfunc(ops, nops, rng);
             hf_compile(ops, nops, buf);
             execbuf_lock(buf);
             hashptr = buf;
+            batchptr = hf_batch(buf);
         } else if (dynamic) {
-            hashptr = load_function(dynamic);
+            hashptr = load_function(dynamic, &batchptr);
+            unhashptr = dlsym(dlopen(dynamic, RTLD_NOW), "unhash");
         } else {
             fprintf(stderr, "prospector: must supply -p or -l\n");
             exit(EXIT_FAILURE);
         }
 
-        if (flags & F_U64) {
-            uint64_t ABI (*hash)(uint64_t) = hashptr;
-            uint64_t i = 0;
-            do
-                printf("%016llx %016llx\n",
-                        (unsigned long long)i,
-                        (unsigned long long)hash(i));
-            while (++i);
-        } else {
-            uint32_t ABI (*hash)(uint32_t) = hashptr;
-            uint32_t i = 0;
-            do
-                printf("%08lx %08lx\n",
-                        (unsigned long)i,
-                        (unsigned long)hash(i));
-            while (++i);
+        if (mode == MODE_CYCLES) {
+            if (flags & F_U64) {
+                fprintf(stderr, "prospector: -D requires 32-bit functions\n");
+                exit(EXIT_FAILURE);
+            }
+            return cycle_run(hashptr, batchptr);
         }
-        return 0;
-    }
-
-    for (;;) {
-        /* Generate */
-        if (template) {
-            hf_randfunc(ops, nops, rng);
-        } else {
-            nops = min + xoroshiro128plus(rng) % (max - min + 1);
-            hf_genfunc(ops, nops, flags, rng);
+        if (mode == MODE_VERIFY) {
+            if (flags & F_U64 && !unhashptr) {
+                fprintf(stderr, "prospector: -8 -V requires unhash()\n");
+                exit(EXIT_FAILURE);
+            }
+            return verify_run(hashptr, batchptr, unhashptr, flags) ?
+                   EXIT_FAILURE : 0;
         }
-
-        /* Evaluate */
-        double score;
-        hf_compile(ops, nops, buf);
-        execbuf_lock(buf);
-        if (flags & F_U64) {
-            uint64_t ABI (*hash)(uint64_t) = (void *)buf;
-            score = estimate_bias64(hash, rng);
-        } else {
-            uint32_t ABI (*hash)(uint32_t) = (void *)buf;
-            score = estimate_bias32(hash, rng);
+        if (!(flags & F_U64) && list_last > 0xffffffff)
+            list_last = 0xffffffff;
+        if (list_first > list_last) {
+            fprintf(stderr, "prospector: invalid input range (-I)\n");
+            exit(EXIT_FAILURE);
         }
-        execbuf_unlock(buf);
+        if (mode == MODE_BENCH)
+            bench(hashptr, batchptr, flags);
+        else if (mode == MODE_STREAM)
+            stream_run(hashptr, batchptr, flags, stream_seed, stream_stride);
+        else if (output)
+            list_binary(hashptr, batchptr, flags, list_first, list_last,
+                        output);
+        else
+            list_text(hashptr, batchptr, flags, list_first, list_last);
+        return 0;
+    }
 
-        /* Compare */
-        if (score < best) {
-            printf("// score = %.17g\n", score);
-            hf_printfunc(ops, nops, stdout);
-            fflush(stdout);
-            best = score;
+    static struct search search;
+    search.flags = flags;
+    search.min = min;
+    search.max = max;
+    search.nops = nops;
+    search.template = template ? ops : 0;
+    search.threshold = best;
+    search.pareto = pareto;
+    search.budget = budget;
+    search.nelite = nelite;
+    search.verifiers = verifiers;
+    search.checkpoint = checkpoint;
+    search.metrics = metrics;
+    search.keyhash = keys_hash(flags & F_U64 ? 64 : 32);
+    if (pareto || budget)
+        hf_calibrate(flags, template ? ops : 0, nops, buf);
+    if (resume) {
+        switch (search_load(&search, rng)) {
+            case 0:
+                fprintf(stderr, "prospector: no checkpoint at %s, "
+                        "starting over\n", checkpoint);
+                break;
+            case -1:
+                fprintf(stderr, "prospector: invalid checkpoint: %s\n",
+                        checkpoint);
+                exit(EXIT_FAILURE);
+            case -2:
+                fprintf(stderr, "prospector: checkpoint %s scores by a "
+                        "different objective (-W, -d, -K)\n", checkpoint);
+                exit(EXIT_FAILURE);
         }
     }
+
+    search_run(&search, rng);
 }
@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdint.h>
 
 // exact bias: 0.26398543281818287
@@ -12,3 +13,19 @@ hash(uint32_t x)
     x ^= x >> 16;
     return x;
 }
+
+// Optional batched form, which the compiler can vectorize
+__attribute__((sysv_abi))
+void
+hash_batch(const uint32_t *in, uint32_t *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = in[i];
+        x ^= x >> 16;
+        x *= 0x85ebca6b;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35;
+        x ^= x >> 16;
+        out[i] = x;
+    }
+}